@@ -1,5 +1,6 @@
 #include <charconv>
 #include <chrono>
+#include <concepts>
 #include <format>
 #include <iostream>
 #include <print>
@@ -162,6 +163,8 @@ template <auto ParseFn, auto Part1Fn, auto Part2Fn>
   auto p1 = [&] {
     if constexpr (std::is_constructible_v<std::string, decltype(part1)>) {
       return part1;
+    } else if constexpr (std::same_as<std::remove_cv_t<decltype(part1)>, util::Int128>) {
+      return util::ToString(part1);
     } else {
       return std::to_string(part1);
     }
@@ -187,6 +190,8 @@ template <auto ParseFn, auto Part1Fn, auto Part2Fn>
   auto p2 = [&] {
     if constexpr (std::is_constructible_v<std::string, decltype(part2)>) {
       return part2;
+    } else if constexpr (std::same_as<std::remove_cv_t<decltype(part2)>, util::Int128>) {
+      return util::ToString(part2);
     } else {
       return std::to_string(part2);
     }
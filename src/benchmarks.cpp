@@ -42,3 +42,11 @@ EMIT_BENCHMARK(Day11);
 EMIT_BENCHMARK(Day12);
 EMIT_BENCHMARK(Day13);
 EMIT_BENCHMARK(Day14);
+
+TEST_CASE("Day06 Loop Test Benchmark") {
+  std::string file = util::ReadFile("inputs/Day06.txt");
+  decltype(auto) parsed = Day06Parse(file);
+  BENCHMARK("Hash") { return Day06CountLoops(parsed, Day06LoopTest::Hash); };
+  BENCHMARK("Epoch") { return Day06CountLoops(parsed, Day06LoopTest::Epoch); };
+  BENCHMARK("Graph") { return Day06CountLoops(parsed, Day06LoopTest::Graph); };
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <numeric>
+#include <vector>
+
+/// \brief Packed bitmap over cells
+class Bitset {
+  static constexpr std::size_t Bits{64};
+
+  std::vector<std::uint64_t> words_;
+
+public:
+  explicit Bitset(std::size_t size) : words_((size + Bits - 1) / Bits, 0) {
+  }
+
+  inline void Set(std::size_t i) noexcept {
+    words_[i / Bits] |= std::uint64_t{1} << (i % Bits);
+  }
+
+  /// sets `count` bits starting at `first`, `stride` apart
+  inline void Set(std::size_t first, std::ptrdiff_t stride, int count) noexcept {
+    for (int n = 0; n < count; ++n, first += static_cast<std::size_t>(stride)) {
+      Set(first);
+    }
+  }
+
+  /// sets bit `i`, returning whether it was previously clear
+  [[nodiscard]] inline bool Insert(std::size_t i) noexcept {
+    std::uint64_t const mask{std::uint64_t{1} << (i % Bits)};
+    std::uint64_t& word{words_[i / Bits]};
+    bool const inserted{(word & mask) == 0};
+    word |= mask;
+    return inserted;
+  }
+
+  /// sets bit `i`; safe to call concurrently
+  inline void AtomicSet(std::size_t i) noexcept {
+    std::atomic_ref{words_[i / Bits]}.fetch_or(std::uint64_t{1} << (i % Bits), std::memory_order_relaxed);
+  }
+
+  inline Bitset& operator|=(Bitset const& other) noexcept {
+    std::ranges::transform(words_, other.words_, words_.begin(), std::bit_or{});
+    return *this;
+  }
+
+  [[nodiscard]] inline long Count() const noexcept {
+    return std::transform_reduce(words_.begin(), words_.end(), 0L, std::plus{},
+                                 [](std::uint64_t w) { return std::popcount(w); });
+  }
+};
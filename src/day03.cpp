@@ -1,42 +1,254 @@
 module;
 
-#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <cstring>
 #include <ranges>
 #include <string_view>
-
-#include <ctre.hpp>
+#include <utility>
+#include <vector>
 
 export module day03;
 
-export using Day03ParsedType = std::string_view;
-export using Day03AnswerType = long;
+import threading;
 
-namespace stdv = std::views;
+namespace {
 
-export Day03ParsedType Day03Parse(std::string_view input) noexcept {
-  return input;
+constexpr std::uint64_t Broadcast(unsigned char c) noexcept {
+  return 0x0101010101010101ULL * c;
 }
 
-constexpr auto DoMultiply = [](auto&& match) -> long {
-  auto [_, a, b] = match;
-  return a.template to_number<long>() * b.template to_number<long>();
-};
+// Word-at-a-time prefilter: find the next position that could begin an instruction ('m' or 'd')
+std::size_t FindCandidate(std::string_view data, std::size_t i) noexcept {
+  static_assert(std::endian::native == std::endian::little);
+  constexpr std::uint64_t Low{Broadcast(0x01)}, High{Broadcast(0x80)};
+  constexpr std::uint64_t M{Broadcast('m')}, D{Broadcast('d')};
+  constexpr auto ZeroBytes = [](std::uint64_t x) { return (x - Low) & ~x & High; };
+  for (; i + sizeof(std::uint64_t) <= data.size(); i += sizeof(std::uint64_t)) {
+    std::uint64_t word;
+    std::memcpy(&word, data.data() + i, sizeof(word));
+    // only bits above a true match can be false positives, so the lowest set bit is always exact
+    if (std::uint64_t const hits{ZeroBytes(word ^ M) | ZeroBytes(word ^ D)}; hits != 0) {
+      return i + static_cast<std::size_t>(std::countr_zero(hits) / 8);
+    }
+  }
+  while (i < data.size() and data[i] != 'm' and data[i] != 'd') {
+    ++i;
+  }
+  return i;
+}
+
+} // namespace
+
+/// \brief Single-pass scanner for `mul(a,b)`, `do()`, and `don't()` instructions
+///
+/// Input may be fed incrementally -- partial instructions are carried across calls to Feed. The enabled
+/// sum is tracked relative to the first `do()`/`don't()` seen so that the scanner can start on an
+/// arbitrary chunk without knowing whether multiplication is enabled there.
+export class Day03Scanner {
+  enum class State : unsigned char { Idle, M, Mu, Mul, Lhs, Rhs, D, Do, DoOpen, Don, DonQ, DonT, DontOpen };
+  enum class Directive : unsigned char { None, Do, Dont };
+
+  State state_{State::Idle};
+  Directive directive_{Directive::None};
+  unsigned digits_{0};
+  long lhs_{0}, rhs_{0};
+  // leading_ holds products before the first directive; trailing_ holds enabled products after it
+  long total_{0}, leading_{0}, trailing_{0};
+
+  [[nodiscard]] static constexpr bool IsDigit(char c) noexcept {
+    return '0' <= c and c <= '9';
+  }
+
+  constexpr void Step(char c) noexcept {
+    switch (state_) {
+    case State::Idle:
+      break;
+    case State::M:
+      if (c == 'u') {
+        state_ = State::Mu;
+        return;
+      }
+      break;
+    case State::Mu:
+      if (c == 'l') {
+        state_ = State::Mul;
+        return;
+      }
+      break;
+    case State::Mul:
+      if (c == '(') {
+        state_ = State::Lhs;
+        digits_ = 0;
+        lhs_ = 0;
+        return;
+      }
+      break;
+    case State::Lhs:
+      if (IsDigit(c)) {
+        ++digits_;
+        lhs_ = lhs_ * 10 + (c - '0');
+        return;
+      } else if (c == ',' and digits_ > 0) {
+        state_ = State::Rhs;
+        digits_ = 0;
+        rhs_ = 0;
+        return;
+      }
+      break;
+    case State::Rhs:
+      if (IsDigit(c)) {
+        ++digits_;
+        rhs_ = rhs_ * 10 + (c - '0');
+        return;
+      } else if (c == ')' and digits_ > 0) {
+        long const product{lhs_ * rhs_};
+        total_ += product;
+        switch (directive_) {
+        case Directive::None:
+          leading_ += product;
+          break;
+        case Directive::Do:
+          trailing_ += product;
+          break;
+        case Directive::Dont:
+          break;
+        }
+        state_ = State::Idle;
+        return;
+      }
+      break;
+    case State::D:
+      if (c == 'o') {
+        state_ = State::Do;
+        return;
+      }
+      break;
+    case State::Do:
+      if (c == '(') {
+        state_ = State::DoOpen;
+        return;
+      } else if (c == 'n') {
+        state_ = State::Don;
+        return;
+      }
+      break;
+    case State::DoOpen:
+      if (c == ')') {
+        directive_ = Directive::Do;
+        state_ = State::Idle;
+        return;
+      }
+      break;
+    case State::Don:
+      if (c == '\'') {
+        state_ = State::DonQ;
+        return;
+      }
+      break;
+    case State::DonQ:
+      if (c == 't') {
+        state_ = State::DonT;
+        return;
+      }
+      break;
+    case State::DonT:
+      if (c == '(') {
+        state_ = State::DontOpen;
+        return;
+      }
+      break;
+    case State::DontOpen:
+      if (c == ')') {
+        directive_ = Directive::Dont;
+        state_ = State::Idle;
+        return;
+      }
+      break;
+    }
+    // mismatch (or idle) -- 'm' and 'd' only ever begin an instruction, so restarting here is exact
+    state_ = (c == 'm') ? State::M : (c == 'd') ? State::D : State::Idle;
+  }
+
+public:
+  void Feed(std::string_view chunk) noexcept {
+    for (std::size_t i{0}; i < chunk.size();) {
+      if (state_ == State::Idle) {
+        if (i = FindCandidate(chunk, i); i == chunk.size()) {
+          break;
+        }
+      }
+      Step(chunk[i++]);
+    }
+  }
+
+  /// finish an instruction that is in progress with bytes from `tail` without starting any new ones
+  void Complete(std::string_view tail) noexcept {
+    for (char const c : tail) {
+      if (state_ == State::Idle or c == 'm' or c == 'd') {
+        break;
+      }
+      Step(c);
+    }
+  }
 
-constexpr auto GetMuls = [](auto&& range) {
-  return ctre::search_all<R"(mul\((\d+),(\d+)\))">(range) | stdv::transform(DoMultiply);
+  /// sum of all multiplications seen so far
+  [[nodiscard]] constexpr long Total() const noexcept {
+    return total_;
+  }
+
+  /// sum of multiplications seen so far that were not disabled by `don't()`
+  [[nodiscard]] constexpr long Enabled(bool initially_enabled = true) const noexcept {
+    return (initially_enabled ? leading_ : 0L) + trailing_;
+  }
+
+  /// whether multiplication is enabled after everything seen so far
+  [[nodiscard]] constexpr bool EnabledAfter(bool initially_enabled = true) const noexcept {
+    return (directive_ == Directive::None) ? initially_enabled : (directive_ == Directive::Do);
+  }
 };
 
-export Day03AnswerType Day03Part1(Day03ParsedType const& data) {
-  return std::ranges::fold_left(GetMuls(data), 0L, std::plus{});
+export using Day03ParsedType = std::pair<long, long>;
+export using Day03AnswerType = long;
+
+/// Scan `input` split into `chunks` pieces on the thread pool.
+///
+/// Each chunk owns the instructions that begin within it and completes a straddling one by reading past
+/// its end. Chunk sums are computed relative to an unknown starting state and resolved by a prefix pass.
+export Day03ParsedType Day03ParallelScan(std::string_view input, unsigned chunks) noexcept {
+  std::vector<Day03Scanner> scanners(chunks);
+  auto bound = [&](unsigned i) { return i * input.size() / chunks; };
+  threading::ParallelForEach(std::views::iota(0U, chunks), [&](unsigned i) {
+    std::size_t const begin{bound(i)}, end{bound(i + 1)};
+    scanners[i].Feed(input.substr(begin, end - begin));
+    scanners[i].Complete(input.substr(end));
+  });
+  long total{0}, enabled_total{0};
+  for (bool enabled{true}; Day03Scanner const& scanner : scanners) {
+    total += scanner.Total();
+    enabled_total += scanner.Enabled(enabled);
+    enabled = scanner.EnabledAfter(enabled);
+  }
+  return std::pair{total, enabled_total};
 }
 
-constexpr auto OnlyValid = [](auto&& x) { return ctre::split<R"(don't\(\))">(x) | stdv::take(1); };
+// small inputs are faster to scan serially than to hand off to the thread pool
+constexpr std::size_t ParallelThreshold{1ZU << 20};
 
-constexpr auto FilterValid = [](std::string_view data) {
-  return ctre::split<R"(do\(\))">(data) | stdv::transform(OnlyValid) | stdv::join;
-};
+export Day03ParsedType Day03Parse(std::string_view input) noexcept {
+  if (input.size() >= ParallelThreshold) {
+    return Day03ParallelScan(input, threading::GetNumThreads());
+  }
+  Day03Scanner scanner;
+  scanner.Feed(input);
+  return std::pair{scanner.Total(), scanner.Enabled()};
+}
+
+export Day03AnswerType Day03Part1(Day03ParsedType const& data) {
+  return data.first;
+}
 
 export Day03AnswerType Day03Part2(Day03ParsedType const& data,
                                   [[maybe_unused]] Day03AnswerType const& answer) {
-  return std::ranges::fold_left(FilterValid(data) | stdv::transform(GetMuls) | stdv::join, 0L, std::plus{});
+  return data.second;
 }
@@ -1,67 +1,132 @@
 module;
 
+#include <array>
+#include <bit>
+#include <cstdint>
 #include <string_view>
+#include <utility>
+#include <vector>
 
 export module day04;
 
-export using Day04ParsedType = std::string_view;
-export using Day04AnswerType = long;
+namespace {
 
-export Day04ParsedType Day04Parse(std::string_view input) noexcept {
-  return input;
-}
+enum class Letter : unsigned char { X = 0, M = 1, A = 2, S = 3 };
+
+/// \brief Bit-plane view of a letter grid -- one bitmask row per letter
+///
+/// Bit `x` of word `w` in a row represents column `64 * w + x`. Each row is padded with a zero word on
+/// both sides so that shifted reads never need bounds checks; bits beyond the grid width are always zero.
+class Bitboard {
+  static constexpr std::size_t Bits{64};
+
+  std::vector<std::uint64_t> planes_;
+
+  [[nodiscard]] constexpr inline std::size_t Stride() const noexcept {
+    return words + 2;
+  }
+
+  [[nodiscard]] constexpr inline std::size_t Offset(Letter l, std::size_t y) const noexcept {
+    return (static_cast<std::size_t>(std::to_underlying(l)) * height + y) * Stride() + 1;
+  }
 
-constexpr std::string_view XMAS{"XMAS"};
-constexpr std::string_view SAMX{"SAMX"};
-constexpr long N{4};
+public:
+  std::size_t width, height, words;
 
-constexpr auto CheckForXMASFrom = [](std::string_view data, std::size_t offset, std::size_t delta) {
-  auto check = [&](std::string_view s) {
-    for (std::size_t i = 0, o = offset; i < s.size(); ++i, o += delta) {
-      if (data[o] != s[i]) {
-        return false;
+  explicit Bitboard(std::string_view grid)
+      : width{grid.find('\n')},
+        height{grid.size() / (width + 1)},
+        words{(width + Bits - 1) / Bits} {
+    planes_.assign(4 * height * Stride(), 0);
+    for (std::size_t y = 0; y < height; ++y) {
+      for (std::size_t x = 0; x < width; ++x) {
+        Letter letter;
+        switch (grid[y * (width + 1) + x]) {
+        case 'X':
+          letter = Letter::X;
+          break;
+        case 'M':
+          letter = Letter::M;
+          break;
+        case 'A':
+          letter = Letter::A;
+          break;
+        case 'S':
+          letter = Letter::S;
+          break;
+        default:
+          continue;
+        }
+        planes_[Offset(letter, y) + x / Bits] |= std::uint64_t{1} << (x % Bits);
       }
     }
-    return true;
-  };
-  return check(XMAS) or check(SAMX);
+  }
+
+  /// Word `w` of row `y` for letter `l` where bit `x` holds column `x + shift` (|shift| < 64)
+  [[nodiscard]] inline std::uint64_t Word(Letter l, std::size_t y, std::size_t w, int shift) const noexcept {
+    std::uint64_t const* row{planes_.data() + Offset(l, y) + w};
+    if (shift > 0) {
+      auto const s{static_cast<unsigned>(shift)};
+      return (row[0] >> s) | (row[1] << (Bits - s));
+    } else if (shift < 0) {
+      auto const s{static_cast<unsigned>(-shift)};
+      return (row[0] << s) | (row[-1] >> (Bits - s));
+    } else {
+      return row[0];
+    }
+  }
+};
+
+constexpr std::array XMAS{Letter::X, Letter::M, Letter::A, Letter::S};
+constexpr std::array SAMX{Letter::S, Letter::A, Letter::M, Letter::X};
+
+struct Direction {
+  std::size_t dy;
+  int dx;
 };
 
-export Day04AnswerType Day04Part1(Day04ParsedType const& data) {
+// the remaining four directions are covered by matching SAMX in these
+constexpr std::array Directions{Direction{0, 1}, Direction{1, 0}, Direction{1, 1}, Direction{1, -1}};
+
+} // namespace
+
+export using Day04ParsedType = Bitboard;
+export using Day04AnswerType = long;
+
+export Day04ParsedType Day04Parse(std::string_view input) noexcept {
+  return Bitboard{input};
+}
+
+export Day04AnswerType Day04Part1(Day04ParsedType const& board) {
   long count{0};
-  std::size_t const x_count{data.find('\n')};
-  std::size_t const w(x_count + 1);
-  std::size_t const y_count{data.size() / w};
-  for (std::size_t y = 0; y < y_count; ++y) {
-    bool const do_y{y + N <= y_count};
-    for (std::size_t x = 0; x < x_count; ++x) {
-      bool const do_x{x + N <= x_count};
-      std::size_t const offset{y * w + x};
-      count += // horizonal
-          (do_x and CheckForXMASFrom(data, offset, 1)) +
-          // vertical
-          (do_y and CheckForXMASFrom(data, offset, w)) +
-          // top-left to bottom-right
-          (do_y and do_x and CheckForXMASFrom(data, offset, w + 1)) +
-          // top-right to bottom-left
-          (do_y and do_x and CheckForXMASFrom(data, offset + N - 1, w - 1));
+  for (auto const [dy, dx] : Directions) {
+    for (std::size_t y = 0; y + 3 * dy < board.height; ++y) {
+      for (std::size_t w = 0; w < board.words; ++w) {
+        auto match = [&](auto const& word) {
+          std::uint64_t bits{~std::uint64_t{0}};
+          for (std::size_t i = 0; i < word.size(); ++i) {
+            bits &= board.Word(word[i], y + i * dy, w, static_cast<int>(i) * dx);
+          }
+          return std::popcount(bits);
+        };
+        count += match(XMAS) + match(SAMX);
+      }
     }
   }
   return count;
 }
 
-export Day04AnswerType Day04Part2(Day04ParsedType const& data,
+export Day04AnswerType Day04Part2(Day04ParsedType const& board,
                                   [[maybe_unused]] Day04AnswerType const& answer) {
   long count{0};
-  std::size_t const x_count{data.find('\n')};
-  std::size_t const w(x_count + 1);
-  std::size_t const y_count{data.size() / w};
-  for (std::size_t y = 1; y < y_count - 1; ++y) {
-    for (std::size_t x = 1; x < x_count - 1; ++x) {
-      std::size_t const offset{y * w + x};
-      count += (data[offset] == 'A' and // center is A and diagonals must be SAM/MAS
-                (data[offset - (w + 1)] + data[offset + (w + 1)]) == ('S' + 'M') and
-                (data[offset - (w - 1)] + data[offset + (w - 1)]) == ('S' + 'M'));
+  for (std::size_t y = 1; y + 1 < board.height; ++y) {
+    for (std::size_t w = 0; w < board.words; ++w) {
+      // each diagonal through the center A must read MAS or SAM
+      auto diagonal = [&](int from, int to) {
+        return (board.Word(Letter::M, y - 1, w, from) & board.Word(Letter::S, y + 1, w, to)) |
+               (board.Word(Letter::S, y - 1, w, from) & board.Word(Letter::M, y + 1, w, to));
+      };
+      count += std::popcount(board.Word(Letter::A, y, w, 0) & diagonal(-1, 1) & diagonal(1, -1));
     }
   }
   return count;
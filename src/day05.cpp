@@ -1,84 +1,172 @@
 module;
 
-#include <algorithm>
-#include <array>
-#include <functional>
+#include <bit>
+#include <charconv>
+#include <cstdint>
 #include <ranges>
+#include <span>
 #include <string_view>
 #include <utility>
 #include <vector>
 
-#include <ctre.hpp>
+#include <ankerl/unordered_dense.h>
 
 export module day05;
 
-// Model the entire ruleset as a big(?) lookup table -- density is around 14.5%
-constexpr int Lower{10};
-constexpr int Upper{99};
-constexpr int Size{Upper - Lower + 1};
-using Rules = std::array<bool, static_cast<std::uint32_t>(Size* Size)>;
+import threading;
 
-using Update = std::vector<int>;
+namespace {
 
-export struct Day05ParsedType {
-  Rules rules;
-  std::vector<Update> updates;
+// Model the entire ruleset as a bit matrix sized from the data -- row `b` holds every page that must be
+// printed before `b`. Density is low, but rows are only ever read at the words an update touches.
+class Rules {
+  static constexpr std::size_t Bits{64};
+
+  std::size_t words_{0};
+  std::vector<std::uint64_t> bits_;
+
+public:
+  constexpr Rules() noexcept = default;
+
+  explicit Rules(std::size_t pages) : words_{(pages + Bits - 1) / Bits}, bits_(pages * words_, 0) {
+  }
+
+  inline void Add(std::uint32_t before, std::uint32_t after) noexcept {
+    bits_[after * words_ + before / Bits] |= std::uint64_t{1} << (before % Bits);
+  }
+
+  [[nodiscard]] constexpr inline std::size_t Words() const noexcept {
+    return words_;
+  }
+
+  [[nodiscard]] constexpr inline std::uint64_t Word(std::uint32_t page, std::size_t word) const noexcept {
+    return bits_[page * words_ + word];
+  }
 };
-export using Day05AnswerType = int;
 
-constexpr auto Rule = [](std::ranges::random_access_range auto&& array, int a, int b) -> decltype(auto) {
-  return array[static_cast<std::uint32_t>(a * Size + b)];
+// Page numbers are remapped to dense indices in the order they are first seen
+struct Manual {
+  Rules rules;
+  // dense index -> page number
+  std::vector<long> ids;
+  // every update back to back; update `i` is pages[offsets[i], offsets[i + 1])
+  std::vector<std::uint32_t> pages, offsets;
+
+  [[nodiscard]] constexpr inline std::size_t Updates() const noexcept {
+    return offsets.size() - 1;
+  }
+
+  [[nodiscard]] constexpr inline std::span<std::uint32_t const> Update(std::size_t i) const noexcept {
+    return std::span{pages}.subspan(offsets[i], offsets[i + 1] - offsets[i]);
+  }
 };
 
+} // namespace
+
+export using Day05ParsedType = Manual;
+export using Day05AnswerType = long;
+
 export Day05ParsedType Day05Parse(std::string_view input) noexcept {
-  Day05ParsedType parsed;
-  std::size_t const split{input.find("\n\n")};
-  parsed.rules.fill(false);
-  for (auto match : ctre::search_all<R"((\d\d)\|(\d\d))">(input.substr(0, split))) {
-    auto [_, a, b] = match;
-    Rule(parsed.rules, a.to_number() - Lower, b.to_number() - Lower) = true;
+  Manual manual;
+  ankerl::unordered_dense::map<long, std::uint32_t> dense;
+  char const* i{input.data()};
+  char const* const end{input.data() + input.size()};
+  auto page = [&] {
+    long value{0};
+    i = std::from_chars(i, end, value).ptr;
+    auto const [it, inserted] = dense.try_emplace(value, static_cast<std::uint32_t>(manual.ids.size()));
+    if (inserted) {
+      manual.ids.push_back(value);
+    }
+    return it->second;
+  };
+  // rules -- `a|b` per line, up to a blank line
+  std::vector<std::pair<std::uint32_t, std::uint32_t>> rules;
+  while (i != end and *i != '\n') {
+    std::uint32_t const before{page()};
+    // advance past '|'
+    ++i;
+    std::uint32_t const after{page()};
+    // advance past '\n'
+    ++i;
+    rules.emplace_back(before, after);
+  }
+  // updates -- comma-separated pages per line
+  manual.offsets.push_back(0);
+  while (i != end) {
+    if (*i == '\n') {
+      ++i;
+      continue;
+    }
+    do {
+      manual.pages.push_back(page());
+    } while (i != end and *i++ == ',');
+    manual.offsets.push_back(static_cast<std::uint32_t>(manual.pages.size()));
   }
-  parsed.updates = ctre::split<"\n">(input.substr(split + 2)) |
-                   std::views::filter([](auto&& line) { return line.size() > 0; }) |
-                   std::views::transform([]<typename Line>(Line&& line) {
-                     return ctre::search_all<R"(\d\d)">(std::forward<Line>(line)) |
-                            std::views::transform([](auto&& num) { return num.to_number() - Lower; }) |
-                            std::ranges::to<Update>();
-                   }) |
-                   std::ranges::to<std::vector>();
-  return parsed;
+  // all pages are known now, so the rule matrix can be sized
+  manual.rules = Rules{manual.ids.size()};
+  for (auto const& [before, after] : rules) {
+    manual.rules.Add(before, after);
+  }
+  return manual;
 }
 
-constexpr auto Comparator = [](Rules const& rules) {
-  return [&rules](int a, int b) { return Rule(rules, a, b); };
-};
-
-constexpr auto CheckSorted = []<typename Comp>(Comp&& comparator, std::vector<int> const& update) {
-  return std::ranges::is_sorted(update, std::forward<Comp>(comparator));
+// The rank of a page within an update is the number of other pages in the update that must precede it.
+// An update is sorted exactly when every page sits at its rank, and the sorted midpoint is the page whose
+// rank is half the update's length -- no sorting required.
+struct Ranking {
+  bool sorted;
+  long midpoint;
 };
 
-constexpr auto GetMidpoint = [](std::vector<int> const& range) { return Lower + range[range.size() / 2]; };
+static Ranking Rank(Manual const& manual, std::span<std::uint32_t const> update) noexcept {
+  thread_local std::vector<std::uint64_t> mask;
+  thread_local std::vector<std::size_t> touched;
+  if (mask.size() < manual.rules.Words()) {
+    mask.resize(manual.rules.Words(), 0);
+  }
+  touched.clear();
+  for (std::uint32_t const page : update) {
+    std::uint64_t& word{mask[page / 64]};
+    if (word == 0) {
+      touched.push_back(page / 64);
+    }
+    word |= std::uint64_t{1} << (page % 64);
+  }
+  Ranking result{.sorted = true, .midpoint = 0};
+  for (auto const [index, page] : std::views::enumerate(update)) {
+    long rank{0};
+    for (std::size_t const word : touched) {
+      rank += std::popcount(manual.rules.Word(page, word) & mask[word]);
+    }
+    result.sorted = result.sorted and rank == index;
+    if (std::cmp_equal(rank, update.size() / 2)) {
+      result.midpoint = manual.ids[page];
+    }
+  }
+  for (std::size_t const word : touched) {
+    mask[word] = 0;
+  }
+  return result;
+}
 
 export Day05AnswerType Day05Part1(Day05ParsedType const& data) {
-  auto check = std::bind_front(CheckSorted, Comparator(data.rules));
-  return std::ranges::fold_left(data.updates | std::views::filter(std::move(check)) |
-                                    std::views::transform(GetMidpoint),
-                                0,
-                                std::plus{});
+  return threading::ParallelReduceAdd(
+      std::views::iota(0ZU, data.Updates()),
+      [&](std::size_t i) {
+        auto const [sorted, midpoint] = Rank(data, data.Update(i));
+        return sorted ? midpoint : 0L;
+      },
+      0L);
 }
 
-constexpr auto SortAndGetMidpoint = [](auto&& comparator, std::vector<int> update) {
-  auto midpoint = update.begin() + static_cast<long>(update.size() / 2);
-  std::ranges::nth_element(update, midpoint, comparator);
-  return GetMidpoint(update);
-};
-
 export Day05AnswerType Day05Part2(Day05ParsedType const& data,
                                   [[maybe_unused]] Day05AnswerType const& answer) {
-  auto check = std::not_fn(std::bind_front(CheckSorted, Comparator(data.rules)));
-  auto action = std::bind_front(SortAndGetMidpoint, Comparator(data.rules));
-  return std::ranges::fold_left(data.updates | std::views::filter(std::move(check)) |
-                                    std::views::transform(std::move(action)),
-                                0,
-                                std::plus{});
+  return threading::ParallelReduceAdd(
+      std::views::iota(0ZU, data.Updates()),
+      [&](std::size_t i) {
+        auto const [sorted, midpoint] = Rank(data, data.Update(i));
+        return sorted ? 0L : midpoint;
+      },
+      0L);
 }
@@ -1,12 +1,20 @@
 module;
 
 #include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <numeric>
+#include <optional>
 #include <ranges>
+#include <span>
 #include <string_view>
 #include <utility>
+#include <vector>
 
 #include <ankerl/unordered_dense.h>
 
+#include "bitset.hpp"
 #include "point.hpp"
 
 export module day06;
@@ -15,6 +23,43 @@ import threading;
 
 namespace {
 
+/// \brief Dense visited set over guard states, cleared in O(1) by advancing an epoch
+class EpochSet {
+  std::vector<std::uint32_t> stamps_;
+  std::uint32_t epoch_{0};
+
+public:
+  inline void Reset(std::size_t size) {
+    if (stamps_.size() < size) {
+      stamps_.resize(size, 0);
+    }
+    if (++epoch_ == 0) {
+      std::ranges::fill(stamps_, 0);
+      epoch_ = 1;
+    }
+  }
+
+  /// returns false if `index` was already present
+  [[nodiscard]] inline bool Insert(std::size_t index) noexcept {
+    return std::exchange(stamps_[index], epoch_) != epoch_;
+  }
+};
+
+/// \brief Hash-based visited set over guard states (kept as a benchmark baseline)
+class HashSet {
+  ankerl::unordered_dense::set<std::size_t> seen_;
+
+public:
+  inline void Reset([[maybe_unused]] std::size_t size) {
+    seen_.clear();
+  }
+
+  /// returns false if `index` was already present
+  [[nodiscard]] inline bool Insert(std::size_t index) {
+    return seen_.insert(index).second;
+  }
+};
+
 struct Guard {
   Point loc{0, 0};
   Dir dir{Dir::Up};
@@ -47,13 +92,168 @@ public:
   Guard guard;
 
 private:
+  static constexpr std::uint32_t None{std::numeric_limits<std::uint32_t>::max()};
+
   std::string_view grid_;
   std::vector<int> mapping_;
 
+  // Turning states are the states a guard can be in right after turning at an obstacle. They form a
+  // functional graph under "run to the next obstacle and turn", with exit_ as the sink for leaving the map.
+  std::vector<Guard> turns_;
+  std::vector<std::uint32_t> turn_id_;
+  std::vector<std::uint32_t> next_;
+  std::uint32_t exit_{0};
+  // Decomposition of the graph: each state reaches a root (a cycle member or exit_) after depth_ steps.
+  // Trees hanging off the roots are numbered by an Euler tour so "does u's walk pass v" is an interval test.
+  std::vector<std::uint32_t> root_, depth_, tin_, tout_, cycle_, cycle_pos_, cycle_len_;
+  // per cell: the turning states whose run passes over (and so would be stopped by) that cell
+  std::vector<std::uint32_t> cover_offsets_, covers_;
+
   [[nodiscard]] constexpr inline auto GetOffset(Dir id) const noexcept {
     return dim * dim * static_cast<std::size_t>(std::to_underlying(id));
   }
 
+  /// id of the turning state reached from `g` without any added obstacle (exit_ if the guard leaves)
+  [[nodiscard]] inline std::uint32_t NextTurn(Guard g) const noexcept {
+    Step(g, Point{});
+    return InBounds(g.loc) ? turn_id_[g.Index(dim)] : exit_;
+  }
+
+  [[nodiscard]] inline std::span<std::uint32_t const> Covers(Point const& cell) const noexcept {
+    std::size_t const index{cell.Index(dim)};
+    std::size_t const begin{cover_offsets_[index]}, end{cover_offsets_[index + 1]};
+    return std::span{covers_}.subspan(begin, end - begin);
+  }
+
+  /// steps from turning state `from` until the unobstructed walk first reaches `to`, if it ever does
+  [[nodiscard]] inline std::optional<std::uint32_t> Distance(std::uint32_t from,
+                                                              std::uint32_t to) const noexcept {
+    if (std::uint32_t const cycle{cycle_[to]}; cycle != None) {
+      std::uint32_t const root{root_[from]};
+      if (root == exit_ or cycle_[root] != cycle) {
+        return std::nullopt;
+      }
+      std::uint32_t const len{cycle_len_[cycle]};
+      return depth_[from] + (cycle_pos_[to] + len - cycle_pos_[root]) % len;
+    } else if (tin_[to] <= tin_[from] and tin_[from] < tout_[to]) {
+      return depth_[from] - depth_[to];
+    } else {
+      return std::nullopt;
+    }
+  }
+
+  void BuildTurnGraph() {
+    // enumerate turning states: in front of every obstacle, facing right of the approach direction
+    turn_id_.assign(4 * dim * dim, None);
+    for (int y : std::views::iota(0, static_cast<int>(dim))) {
+      for (int x : std::views::iota(0, static_cast<int>(dim))) {
+        if (Point const obstacle{x, y}; Get(obstacle) == '#') {
+          for (Dir const dir : {Dir::Up, Dir::Right, Dir::Down, Dir::Left}) {
+            if (Guard g{obstacle - dir, dir}; InBounds(g.loc) and Get(g.loc) != '#') {
+              g.Turn();
+              turn_id_[g.Index(dim)] = static_cast<std::uint32_t>(turns_.size());
+              turns_.push_back(g);
+            }
+          }
+        }
+      }
+    }
+    exit_ = static_cast<std::uint32_t>(turns_.size());
+    std::size_t const n{turns_.size() + 1};
+    next_.resize(n);
+    for (auto const [id, g] : std::views::enumerate(turns_)) {
+      next_[static_cast<std::size_t>(id)] = NextTurn(g);
+    }
+    next_[exit_] = exit_;
+    // find cycles and the depth of every state above its root
+    root_.assign(n, None);
+    depth_.assign(n, 0);
+    cycle_.assign(n, None);
+    cycle_pos_.assign(n, 0);
+    root_[exit_] = exit_;
+    std::vector<std::uint32_t> stack;
+    std::vector<char> on_stack(n, false);
+    for (std::uint32_t start = 0; start < exit_; ++start) {
+      std::uint32_t u{start};
+      while (root_[u] == None and not on_stack[u]) {
+        on_stack[u] = true;
+        stack.push_back(u);
+        u = next_[u];
+      }
+      if (root_[u] == None) {
+        // walked back onto the stack -- everything from u onwards is a new cycle
+        auto const cycle{static_cast<std::uint32_t>(cycle_len_.size())};
+        auto const first{std::ranges::find(stack, u)};
+        for (auto const [pos, v] : std::views::enumerate(std::ranges::subrange(first, stack.end()))) {
+          root_[v] = v;
+          cycle_[v] = cycle;
+          cycle_pos_[v] = static_cast<std::uint32_t>(pos);
+          on_stack[v] = false;
+        }
+        cycle_len_.push_back(static_cast<std::uint32_t>(stack.end() - first));
+        stack.erase(first, stack.end());
+      }
+      for (std::uint32_t const v : std::views::reverse(stack)) {
+        root_[v] = root_[next_[v]];
+        depth_[v] = depth_[next_[v]] + 1;
+        on_stack[v] = false;
+      }
+      stack.clear();
+    }
+    // Euler tour over the trees hanging off each root (edges reversed: parent is the next state)
+    std::vector<std::uint32_t> child_offsets(n + 1, 0), children(n);
+    for (std::uint32_t v = 0; v < exit_; ++v) {
+      if (cycle_[v] == None) {
+        ++child_offsets[next_[v] + 1];
+      }
+    }
+    std::partial_sum(child_offsets.begin(), child_offsets.end(), child_offsets.begin());
+    std::vector<std::uint32_t> fill(child_offsets.begin(), child_offsets.end() - 1);
+    for (std::uint32_t v = 0; v < exit_; ++v) {
+      if (cycle_[v] == None) {
+        children[fill[next_[v]]++] = v;
+      }
+    }
+    tin_.assign(n, 0);
+    tout_.assign(n, 0);
+    std::uint32_t timer{0};
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> dfs;
+    for (std::uint32_t root = 0; root < n; ++root) {
+      if (root_[root] != root) {
+        continue;
+      }
+      tin_[root] = timer++;
+      dfs.emplace_back(root, child_offsets[root]);
+      while (not dfs.empty()) {
+        auto& [v, child] = dfs.back();
+        if (child == child_offsets[v + 1]) {
+          tout_[v] = timer;
+          dfs.pop_back();
+        } else {
+          std::uint32_t const c{children[child++]};
+          tin_[c] = timer++;
+          dfs.emplace_back(c, child_offsets[c]);
+        }
+      }
+    }
+    // cover lists -- every cell a turning state's run passes over before reaching its obstacle
+    auto for_each_cover = [&](auto&& fn) {
+      for (auto const [id, g] : std::views::enumerate(turns_)) {
+        Guard stop{g};
+        Step(stop, Point{});
+        for (Point p{g.loc}; p != stop.loc and InBounds(p += g.dir);) {
+          fn(p.Index(dim), static_cast<std::uint32_t>(id));
+        }
+      }
+    };
+    cover_offsets_.assign(dim * dim + 1, 0);
+    for_each_cover([&](std::size_t cell, std::uint32_t) { ++cover_offsets_[cell + 1]; });
+    std::partial_sum(cover_offsets_.begin(), cover_offsets_.end(), cover_offsets_.begin());
+    covers_.resize(cover_offsets_.back());
+    std::vector<std::uint32_t> cover_fill(cover_offsets_.begin(), cover_offsets_.end() - 1);
+    for_each_cover([&](std::size_t cell, std::uint32_t id) { covers_[cover_fill[cell]++] = id; });
+  }
+
 public:
   [[nodiscard]] bool InBounds(Point const& pos) const noexcept {
     return 0 <= pos.x and std::cmp_less(pos.x, dim) and 0 <= pos.y and std::cmp_less(pos.y, dim);
@@ -105,6 +305,7 @@ public:
         mapping_[p.Index(dim) + GetOffset(Dir::Right)] = last;
       }
     }
+    BuildTurnGraph();
   }
 
   void Step(Guard& g, Point const& obstacle) const noexcept {
@@ -127,62 +328,116 @@ public:
     g.Turn();
   }
 
-  [[nodiscard]] bool inline HasCycle(Guard g, Point const& obstacle) const noexcept {
-    thread_local ankerl::unordered_dense::set<int> seen;
-    seen.clear();
+  template <typename Seen> [[nodiscard]] bool inline HasCycle(Guard g, Point const& obstacle) const {
+    thread_local Seen seen;
+    seen.Reset(4 * dim * dim);
     while (InBounds(g.loc)) {
-      int const index{static_cast<int>(g.Index(dim))};
-      if (seen.contains(index)) {
+      if (not seen.Insert(g.Index(dim))) {
         return true;
       }
-      seen.insert(index);
       Step(g, obstacle);
     }
     return false;
   }
+
+  /// Loop test on the turning-state graph, patched only where the new obstacle interrupts a run.
+  ///
+  /// Each time the guard hits the new obstacle it does so from one of four directions. In between, it
+  /// follows the unobstructed graph until the first state whose run covers the obstacle, which is found
+  /// directly from that cell's cover list rather than by walking.
+  [[nodiscard]] bool Traps(Guard const& g, Point const& obstacle) const noexcept {
+    unsigned hit{0};
+    for (Dir dir{g.dir};;) {
+      if (unsigned const bit{1U << std::to_underlying(dir)}; (hit & bit) != 0) {
+        return true;
+      } else {
+        hit |= bit;
+      }
+      Guard turned{obstacle - dir, dir};
+      turned.Turn();
+      std::uint32_t const from{NextTurn(turned)};
+      if (from == exit_) {
+        return false;
+      }
+      std::optional<std::uint32_t> best;
+      for (std::uint32_t const to : Covers(obstacle)) {
+        if (auto const distance{Distance(from, to)}; distance and (not best or *distance < *best)) {
+          best = distance;
+          dir = turns_[to].dir;
+        }
+      }
+      if (not best) {
+        // never runs into the new obstacle, so the original fate stands
+        return root_[from] != exit_;
+      }
+    }
+  }
+};
+
+/// \brief The lab map along with the guard's original patrol
+struct Patrol {
+  JumpMap map;
+  // the guard's state just before first stepping onto each newly visited cell
+  std::vector<Guard> path;
 };
 
 } // namespace
 
-export using Day06ParsedType = JumpMap;
+export using Day06ParsedType = Patrol;
 export using Day06AnswerType = long;
 
 export Day06ParsedType Day06Parse(std::string_view input) noexcept {
-  return JumpMap{input};
-}
-
-static std::vector<Guard> path;
-
-export Day06AnswerType Day06Part1(Day06ParsedType const& mapping) {
-  path.reserve(6'000);
-  path.clear();
-  std::vector<char> visited(static_cast<std::size_t>(mapping.dim * mapping.dim), 0);
+  Patrol patrol{.map = JumpMap{input}, .path = {}};
+  JumpMap const& mapping{patrol.map};
+  patrol.path.reserve(6'000);
+  Bitset visited{mapping.dim * mapping.dim};
   Guard g{mapping.guard};
-  long count{1};
   while (mapping.InBounds(g.loc)) {
     while (mapping.InBounds(g.loc + g.dir) and mapping.Get(g.loc + g.dir) == '#') {
       g.Turn();
     }
     Guard const curr{g.Move()};
-    auto const& [pos, _] = g;
-    if (std::size_t const idx{pos.Index(mapping.dim)};
-        mapping.InBounds(pos) and mapping.Get(pos) == '.' and not visited[idx]) {
-      visited[idx] = 1;
-      ++count;
-      path.push_back(curr);
+    if (auto const& [pos, _] = g;
+        mapping.InBounds(pos) and mapping.Get(pos) == '.' and visited.Insert(pos.Index(mapping.dim))) {
+      patrol.path.push_back(curr);
     }
   }
-  return count;
+  return patrol;
 }
 
-export Day06AnswerType Day06Part2(Day06ParsedType const& mapping,
-                                  [[maybe_unused]] Day06AnswerType const& answer) {
-  std::vector<char> added(static_cast<std::size_t>(mapping.dim * mapping.dim), '.');
-  threading::ParallelForEach(path, [&](Guard const& guard) {
+export Day06AnswerType Day06Part1(Day06ParsedType const& data) {
+  // the starting cell is never part of the path
+  return static_cast<long>(data.path.size()) + 1;
+}
+
+static Day06AnswerType CountLoops(Day06ParsedType const& data, auto&& traps) {
+  JumpMap const& mapping{data.map};
+  Bitset added{mapping.dim * mapping.dim};
+  threading::ParallelForEach(data.path, [&](Guard const& guard) {
     Point const obstacle{guard.loc + guard.dir};
-    if (mapping.InBounds(obstacle) and mapping.HasCycle(guard, obstacle)) {
-      added[obstacle.Index(mapping.dim)] = 'X';
+    if (mapping.InBounds(obstacle) and traps(guard, obstacle)) {
+      added.AtomicSet(obstacle.Index(mapping.dim));
     }
   });
-  return std::ranges::count(added, 'X');
+  return added.Count();
+}
+
+export enum class Day06LoopTest { Hash, Epoch, Graph };
+
+/// Count the obstacle placements that trap the guard using the given loop test
+export Day06AnswerType Day06CountLoops(Day06ParsedType const& data, Day06LoopTest test) {
+  switch (test) {
+  case Day06LoopTest::Hash:
+    return CountLoops(data, std::bind_front(&JumpMap::HasCycle<HashSet>, std::cref(data.map)));
+  case Day06LoopTest::Epoch:
+    return CountLoops(data, std::bind_front(&JumpMap::HasCycle<EpochSet>, std::cref(data.map)));
+  case Day06LoopTest::Graph:
+    return CountLoops(data, std::bind_front(&JumpMap::Traps, std::cref(data.map)));
+  }
+  std::unreachable();
+}
+
+export Day06AnswerType Day06Part2(Day06ParsedType const& data,
+                                  [[maybe_unused]] Day06AnswerType const& answer) {
+  return Day06CountLoops(data, Day06LoopTest::Graph);
 }
@@ -1,11 +1,12 @@
 module;
 
-#include <atomic>
 #include <algorithm>
-#include <charconv>
 #include <concepts>
+#include <cstdint>
 #include <functional>
 #include <ranges>
+#include <span>
+#include <stdexcept>
 #include <string_view>
 #include <type_traits>
 #include <vector>
@@ -15,92 +16,209 @@ module;
 export module day07;
 
 import threading;
+import util;
 
 template <bool B> constexpr static inline auto Part2 = std::bool_constant<B>{};
 
-static constexpr auto Div = [] <std::integral T>(T a, std::same_as<T> auto b) {
+static constexpr auto Div = [] <typename T>(T a, std::same_as<T> auto b) {
     return std::pair{a / b, a % b};
 };
 
 template <typename T>
 concept Part2Flag = std::same_as<T, std::bool_constant<true>> or std::same_as<T, std::bool_constant<false>>;
 
-struct Trial {
-  long candidate;
-  std::vector<long> sequence;
+// saturating arithmetic keeps the reachability bounds meaningful for long operand lists
+static constexpr auto SaturatingAdd = [] <typename Int>(Int a, Int b) noexcept {
+  Int result;
+  return __builtin_add_overflow(a, b, &result) ? util::MaxValue<Int> : result;
+};
+
+static constexpr auto SaturatingMul = [] <typename Int>(Int a, Int b) noexcept {
+  Int result;
+  return __builtin_mul_overflow(a, b, &result) ? util::MaxValue<Int> : result;
+};
+
+// A single trial viewed out of the flat operand storage
+template <typename Int> struct Trial {
+  Int candidate;
+  std::span<Int const> sequence;
+  // 10^digits for each operand -- the divisor that strips it off as a concatenated suffix
+  std::span<Int const> shift;
 
 private:
-  [[nodiscard]] bool CanReach(long target, std::size_t iter, Part2Flag auto part2) const noexcept {
-    if (long const curr{sequence[--iter]}; iter == 0) {
-      return target == curr;
-    } else if (long diff = target - curr; diff >= 0 and CanReach(diff, iter, part2)) {
-      return true;
-    } else if (auto const [q, r] = Div(target, curr); r == 0 and CanReach(q, iter, part2)) {
-      return true;
-    } else if constexpr (part2) {
-      long num = 10;
-      while (curr >= num) {
-        num *= 10;
+  // Every operator is increasing in its left operand, so the smallest and largest values a prefix can
+  // produce follow from applying each operator to the previous prefix's bounds.
+  void ComputeBounds(std::vector<Int>& lower, std::vector<Int>& upper, Part2Flag auto part2) const {
+    lower.resize(sequence.size());
+    upper.resize(sequence.size());
+    lower[0] = upper[0] = sequence[0];
+    for (std::size_t i = 1; i < sequence.size(); ++i) {
+      Int const curr{sequence[i]};
+      lower[i] = std::min(SaturatingAdd(lower[i - 1], curr), SaturatingMul(lower[i - 1], curr));
+      upper[i] = std::max(SaturatingAdd(upper[i - 1], curr), SaturatingMul(upper[i - 1], curr));
+      if constexpr (part2) {
+        lower[i] = std::min(lower[i], SaturatingAdd(SaturatingMul(lower[i - 1], shift[i]), curr));
+        upper[i] = std::max(upper[i], SaturatingAdd(SaturatingMul(upper[i - 1], shift[i]), curr));
       }
-      if (auto const [left, right] = Div(target, num); right == curr and CanReach(left, iter, part2)) {
+    }
+  }
+
+  // Works backwards from the target with an explicit stack: undo the last operator (subtract, divide, or
+  // strip a concatenated suffix) and discard any target the remaining prefix can no longer produce.
+  // Targets only ever shrink on the way down, so nothing here can overflow once the trial has been parsed.
+  [[nodiscard]] bool CanReach(Part2Flag auto part2) const noexcept {
+    thread_local std::vector<std::pair<Int, std::size_t>> stack;
+    thread_local std::vector<Int> lower, upper;
+    ComputeBounds(lower, upper, part2);
+    stack.clear();
+    stack.emplace_back(candidate, sequence.size() - 1);
+    while (not stack.empty()) {
+      auto const [target, iter] = stack.back();
+      stack.pop_back();
+      if (target < lower[iter] or target > upper[iter]) {
+        continue;
+      } else if (iter == 0) {
+        // the bounds of a single operand are exact
         return true;
       }
+      Int const curr{sequence[iter]};
+      if constexpr (part2) {
+        if (auto const [left, right] = Div(target, shift[iter]); right == curr) {
+          stack.emplace_back(left, iter - 1);
+        }
+      }
+      if (auto const [q, r] = Div(target, curr); r == 0) {
+        stack.emplace_back(q, iter - 1);
+      }
+      if (Int const diff{target - curr}; diff >= 0) {
+        stack.emplace_back(diff, iter - 1);
+      }
     }
     return false;
   }
 
 public:
-  [[nodiscard]] long Check(Part2Flag auto part2) const noexcept {
-    return CanReach(candidate, sequence.size(), part2) ? candidate : 0;
+  [[nodiscard]] Int Check(Part2Flag auto part2) const noexcept {
+    return CanReach(part2) ? candidate : 0;
   }
 };
 
-export using Day07ParsedType = std::vector<Trial>;
-export using Day07AnswerType = long;
-
-export Day07ParsedType Day07Parse(std::string_view input) noexcept {
-  std::vector<Trial> trials;
-  trials.reserve(850);
-  for (auto i = input.begin(); i != input.end(); ++i) {
-    long target;
-    auto [ii, _] = std::from_chars(i, input.end(), target);
-    // advance past ': '
-    i = ii + 2;
-    std::vector<long> values;
-    values.reserve(12);
-    while (true) {
-      long val;
-      auto [iii, _] = std::from_chars(i, input.end(), val);
-      values.push_back(val);
-      i = iii;
-      if (*i == '\n') {
-        break;
-      }
-      // advance past ' ';
-      ++i;
+// Any value of at most 18 digits -- and its concatenation divisor -- fits in a `long`. Trials with a longer
+// target or operand are rare enough that they are set aside and solved in 128 bits instead, which in turn
+// holds anything up to 38 digits. Past that a trial cannot be represented at all and is rejected.
+static constexpr std::size_t NarrowDigits{18};
+static constexpr std::size_t WideDigits{38};
+
+// Every trial of one integer width, stored back to back: trial `i` owns operands[offsets[i], offsets[i + 1])
+template <typename Int> struct Equations {
+  std::vector<Int> candidates, operands, shifts;
+  std::vector<std::uint32_t> offsets{0};
+
+  [[nodiscard]] constexpr inline std::size_t Size() const noexcept {
+    return candidates.size();
+  }
+
+  [[nodiscard]] constexpr inline Trial<Int> operator[](std::size_t i) const noexcept {
+    std::size_t const first{offsets[i]}, count{offsets[i + 1] - offsets[i]};
+    return Trial<Int>{candidates[i], std::span{operands}.subspan(first, count),
+                      std::span{shifts}.subspan(first, count)};
+  }
+};
+
+struct Calibration {
+  util::Int128 part1{0};
+  util::Int128 part2{0};
+};
+
+export using Day07ParsedType = Calibration;
+export using Day07AnswerType = util::Int128;
+
+// Read the number at `i`, returning it along with 10^digits -- the caller has already checked that both fit
+template <typename Int> static std::pair<Int, Int> ReadNumber(char const*& i, char const* end) noexcept {
+  Int value{0}, shift{1};
+  for (; i != end and '0' <= *i and *i <= '9'; ++i) {
+    value = value * 10 + (*i - '0');
+    shift *= 10;
+  }
+  return {value, shift};
+}
+
+// Read one line, leaving `i` just past its newline -- or at `end` when the input has no trailing newline
+template <typename Int> static void ReadTrial(char const*& i, char const* end, Equations<Int>& equations) {
+  equations.candidates.push_back(ReadNumber<Int>(i, end).first);
+  // advance past ': '
+  i += 2;
+  while (true) {
+    auto const [value, shift] = ReadNumber<Int>(i, end);
+    equations.operands.push_back(value);
+    equations.shifts.push_back(shift);
+    // advance past ' ', or past the newline that ends the trial
+    if (i == end or *i++ == '\n') {
+      break;
     }
-    trials.emplace_back(target, std::move(values));
   }
-  return trials;
+  equations.offsets.push_back(static_cast<std::uint32_t>(equations.operands.size()));
 }
 
-long p2{0};
+// Solve every trial in contiguous bands on the thread pool. Each band sums into its own accumulator; part 2
+// is only checked when part 1 fails.
+template <typename Int> static Calibration Calibrate(Equations<Int> const& equations) {
+  std::size_t const n{equations.Size()};
+  unsigned const bands{std::max(1U, threading::GetNumThreads() / 2)};
+  std::vector<Calibration> partial(bands);
+  threading::ParallelForEach(std::views::iota(0U, bands), [&](unsigned band) {
+    Calibration sums;
+    for (std::size_t i = band * n / bands; i < (band + 1) * n / bands; ++i) {
+      Trial<Int> const trial{equations[i]};
+      if (Int const v1{trial.Check(Part2<false>)}; v1 > 0) {
+        sums.part1 += v1;
+        sums.part2 += v1;
+      } else {
+        sums.part2 += trial.Check(Part2<true>);
+      }
+    }
+    partial[band] = sums;
+  });
+  return std::ranges::fold_left(partial, Calibration{}, [](Calibration acc, Calibration const& c) {
+    return Calibration{acc.part1 + c.part1, acc.part2 + c.part2};
+  });
+}
 
-export Day07AnswerType Day07Part1(Day07ParsedType const& data) noexcept {
-  long p1{0};
-  p2 = 0;
-  // it's faster to conditionally process part 2 with part 1
-  threading::ParallelForEach(data, [&] (Trial const& t) {
-    if (long v1{t.Check(Part2<false>)}; v1 > 0) {
-      std::atomic_ref{p1}.fetch_add(v1, std::memory_order_release);
-    } else if (long v2{t.Check(Part2<true>)}; v2 > 0) {
-      std::atomic_ref{p2}.fetch_add(v2, std::memory_order_release);
+export Day07ParsedType Day07Parse(std::string_view input) {
+  Equations<long> narrow;
+  Equations<util::Int128> wide;
+  narrow.candidates.reserve(1024);
+  narrow.operands.reserve(8192);
+  narrow.shifts.reserve(8192);
+  char const* const end{input.data() + input.size()};
+  for (char const* i{input.data()}; i != end;) {
+    // a single scan of the line proves whether 64-bit evaluation is safe
+    std::size_t digits{0}, longest{0};
+    for (char const* c{i}; c != end and *c != '\n'; ++c) {
+      digits = ('0' <= *c and *c <= '9') ? digits + 1 : 0;
+      longest = std::max(longest, digits);
     }
-  }, /*threads=*/threading::GetNumThreads() / 2);
-  return p1;
+    if (longest <= NarrowDigits) {
+      ReadTrial(i, end, narrow);
+    } else if (longest <= WideDigits) {
+      ReadTrial(i, end, wide);
+    } else {
+      throw std::invalid_argument{"Day07: values longer than 38 digits are not supported"};
+    }
+  }
+  Calibration const narrow_sums{Calibrate(narrow)};
+  if (wide.Size() == 0) {
+    return narrow_sums;
+  }
+  Calibration const wide_sums{Calibrate(wide)};
+  return Calibration{narrow_sums.part1 + wide_sums.part1, narrow_sums.part2 + wide_sums.part2};
+}
+
+export Day07AnswerType Day07Part1(Day07ParsedType const& data) noexcept {
+  return data.part1;
 }
 
-export Day07AnswerType Day07Part2([[maybe_unused]] Day07ParsedType const& data,
-                                  Day07AnswerType const& answer) {
-  return answer + p2;
+export Day07AnswerType Day07Part2(Day07ParsedType const& data,
+                                  [[maybe_unused]] Day07AnswerType const& answer) {
+  return data.part2;
 }
@@ -1,98 +1,142 @@
 module;
 
 #include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
 #include <functional>
+#include <limits>
+#include <numeric>
 #include <ranges>
+#include <span>
 #include <string_view>
+#include <utility>
+#include <vector>
 
+#include "bitset.hpp"
 #include "point.hpp"
 
 export module day08;
 
+import threading;
+
 namespace {
 
-constexpr static std::size_t MaxRepeats{4};
 constexpr static char MinChar{'0'};
 constexpr static char MaxChar{'z'};
 static_assert(MinChar < MaxChar);
 constexpr static std::size_t NumChars{MaxChar - MinChar + 1};
 
-using Lookup = std::array<Point, MaxRepeats * NumChars>;
-
+// Antennas grouped by frequency (CSR) -- frequency `f` owns antennas[offsets[f], offsets[f + 1])
 struct Info {
-  Lookup table;
-  int width;
-};
+  std::vector<Point> antennas;
+  std::array<std::uint32_t, NumChars + 1> offsets;
+  int width, height;
+
+  [[nodiscard]] constexpr inline std::span<Point const> Frequency(std::size_t f) const noexcept {
+    return std::span{antennas}.subspan(offsets[f], offsets[f + 1] - offsets[f]);
+  }
+
+  [[nodiscard]] constexpr inline bool InBounds(Point const& p) const noexcept {
+    return 0 <= p.x and p.x < width and 0 <= p.y and p.y < height;
+  }
 
-constexpr static inline auto InBounds = [](int dim, Point const& loc) {
-  auto const& [x, y] = loc;
-  return 0 <= x and x < dim and 0 <= y and y < dim;
+  /// Number of steps of `delta` that can be taken from `p` while staying on the map
+  [[nodiscard]] constexpr inline int Steps(Point const& p, Point const& delta) const noexcept {
+    auto axis = [](int pos, int dim, int d) {
+      if (d > 0) {
+        return (dim - 1 - pos) / d;
+      } else if (d < 0) {
+        return pos / -d;
+      } else {
+        return std::numeric_limits<int>::max();
+      }
+    };
+    return std::min(axis(p.x, width, delta.x), axis(p.y, height, delta.y));
+  }
 };
 
+// Call `mark(locs, p0, p1)` for every unordered pair of same-frequency antennas on the thread pool. Each
+// antenna's pairs with the antennas after it form one work item; items are dealt round-robin to bands so
+// that large frequencies are spread out, and every band marks into its own bitset before they are merged.
+Bitset MarkPairs(Info const& data, auto&& mark) {
+  std::size_t const bits{static_cast<std::size_t>(data.width * data.height)};
+  unsigned const bands{
+      std::max(1U, std::min(threading::GetNumThreads(), static_cast<unsigned>(data.antennas.size())))};
+  std::vector partial(bands, Bitset{bits});
+  threading::ParallelForEach(std::views::iota(0U, bands), [&](unsigned band) {
+    Bitset& locs{partial[band]};
+    for (std::size_t item{0}, f = 0; f < NumChars; ++f) {
+      std::span<Point const> const letter{data.Frequency(f)};
+      for (std::size_t i = 0; i < letter.size(); ++i) {
+        if (item++ % bands != band) {
+          continue;
+        }
+        for (std::size_t j = i + 1; j < letter.size(); ++j) {
+          mark(locs, letter[i], letter[j]);
+        }
+      }
+    }
+  });
+  for (unsigned band = 1; band < bands; ++band) {
+    partial[0] |= partial[band];
+  }
+  return std::move(partial[0]);
+}
+
 } // namespace
 
 export using Day08ParsedType = Info;
 export using Day08AnswerType = long;
 
-export Day08ParsedType Day08Parse(std::string_view input) noexcept {
-  Lookup table;
-  std::ranges::fill(table, Point{});
-  std::array<std::size_t, NumChars> offsets;
-  offsets.fill(0);
-  int x{0}, y{0};
-  for (char c : input) {
-    if (c == '\n') {
-      x = 0;
-      ++y;
-    } else {
-      if (c != '.') {
-        table[static_cast<std::size_t>(4 * (c - MinChar)) +
-              offsets[static_cast<std::size_t>(c - MinChar)]++] = Point{x, y};
+export Day08ParsedType Day08Parse(std::string_view input) {
+  Info info{.antennas = {}, .offsets = {}, .width = static_cast<int>(input.find('\n')), .height = 0};
+  info.height = static_cast<int>(input.size() / (static_cast<std::size_t>(info.width) + 1));
+  auto frequency = [](char c) {
+    return static_cast<std::size_t>(c - MinChar);
+  };
+  auto is_antenna = [](char c) {
+    return MinChar <= c and c <= MaxChar;
+  };
+  // counting pass sizes each frequency's run, then a second pass fills them in place
+  for (char const c : input) {
+    if (is_antenna(c)) {
+      ++info.offsets[frequency(c) + 1];
+    }
+  }
+  std::partial_sum(info.offsets.begin(), info.offsets.end(), info.offsets.begin());
+  info.antennas.resize(info.offsets.back());
+  std::array<std::uint32_t, NumChars> fill;
+  std::copy_n(info.offsets.begin(), NumChars, fill.begin());
+  for (int y = 0; y < info.height; ++y) {
+    for (int x = 0; x < info.width; ++x) {
+      if (char const c{input[Point{x, y}.Index(info.width + 1)]}; is_antenna(c)) {
+        info.antennas[fill[frequency(c)]++] = Point{x, y};
       }
-      ++x;
     }
   }
-  return Info{.table = table, .width = (static_cast<int>(input.size()) / y) - 1};
+  return info;
 }
 
-export Day08AnswerType Day08Part1(Day08ParsedType const& data) noexcept {
-  std::vector<bool> locs(static_cast<std::size_t>(data.width * data.width), false);
-  for (auto&& candidate : data.table | std::views::chunk(MaxRepeats)) {
-    auto letter = std::views::take_while(candidate, std::bind_front(InBounds, data.width));
-    for (auto const [idx, p0] : std::views::enumerate(letter)) {
-      for (auto const p1 : std::views::drop(letter, idx + 1)) {
-        Point const delta{p1 - p0};
-        if (Point const an0{p0 - delta}; InBounds(data.width, an0)) {
-          locs[an0.Index(data.width)] = true;
-        }
-        if (Point const an1{p1 + delta}; InBounds(data.width, an1)) {
-          locs[an1.Index(data.width)] = true;
-        }
-      }
+export Day08AnswerType Day08Part1(Day08ParsedType const& data) {
+  return MarkPairs(data, [&](Bitset& locs, Point const& p0, Point const& p1) {
+    Point const delta{p1 - p0};
+    if (Point const an0{p0 - delta}; data.InBounds(an0)) {
+      locs.Set(an0.Index(data.width));
     }
-  }
-  return std::ranges::count(locs, true);
+    if (Point const an1{p1 + delta}; data.InBounds(an1)) {
+      locs.Set(an1.Index(data.width));
+    }
+  }).Count();
 }
 
 export Day08AnswerType Day08Part2(Day08ParsedType const& data,
                                   [[maybe_unused]] Day08AnswerType const& answer) {
-  std::vector<bool> locs(static_cast<std::size_t>(data.width * data.width), false);
-  for (auto&& candidate : data.table | std::views::chunk(MaxRepeats)) {
-    auto letter = std::views::take_while(candidate, std::bind_front(InBounds, data.width));
-    for (auto const [idx, p0] : std::views::enumerate(letter)) {
-      for (auto const p1 : std::views::drop(letter, idx + 1)) {
-        locs[p0.Index(data.width)] = true;
-        locs[p1.Index(data.width)] = true;
-        Point const delta{p1 - p0};
-        Point an0{p0}, an1{p1};
-        while (InBounds(data.width, an0 -= delta)) {
-          locs[an0.Index(data.width)] = true;
-        }
-        while (InBounds(data.width, an1 += delta)) {
-          locs[an1.Index(data.width)] = true;
-        }
-      }
-    }
-  }
-  return std::ranges::count(locs, true);
+  return MarkPairs(data, [&](Bitset& locs, Point const& p0, Point const& p1) {
+    // the whole line is known up front, so it is marked as a single strided run without bounds checks
+    Point const delta{p1 - p0};
+    int const back{data.Steps(p0, Point{-delta.x, -delta.y})};
+    Point const first{p0.x - back * delta.x, p0.y - back * delta.y};
+    locs.Set(first.Index(data.width), delta.y * data.width + delta.x, back + 1 + data.Steps(p0, delta));
+  }).Count();
 }
@@ -2,7 +2,7 @@ module;
 
 #include <algorithm>
 #include <functional>
-#include <limits>
+#include <optional>
 #include <ranges>
 #include <string_view>
 #include <utility>
@@ -10,26 +10,39 @@ module;
 
 export module day09;
 
-export using Day09ParsedType = std::vector<unsigned>;
-export using Day09AnswerType = std::size_t;
+import util;
+
+// The disk map is read in place -- one byte per run, never widened into a copy
+export using Day09ParsedType = std::string_view;
+export using Day09AnswerType = util::Int128;
 
 export Day09ParsedType Day09Parse(std::string_view input) noexcept {
   input.remove_suffix(1);
-  return std::ranges::to<std::vector>(
-      std::views::transform(input, [](char c) { return static_cast<unsigned>(c - '0'); }));
+  return input;
+}
+
+static constexpr inline unsigned Digit(char c) noexcept {
+  return static_cast<unsigned>(c - '0');
 }
 
-static inline constexpr std::array TRIANGULAR{0U, 0U, 1U, 3U, 6U, 10U, 15U, 21U, 28U, 36U};
+// Below this many runs there are fewer than 9 * 2^19 blocks and 2^18 file IDs, so a checksum stays below
+// (9 * 2^19)^2 / 2 * 2^18 = 81 * 2^55 < 2^62; anything longer accumulates in 128 bits.
+static constexpr std::size_t NarrowLength{1ZU << 19};
 
+template <typename Sum>
 static inline void
-UpdateChecksum(std::size_t& checksum, unsigned block, unsigned index, unsigned size) noexcept {
-  checksum += static_cast<std::size_t>(index / 2) * (block * size + TRIANGULAR[size]);
+UpdateChecksum(Sum& checksum, std::size_t block, std::size_t index, unsigned size) noexcept {
+  Sum const n{size};
+  // the offsets within a run of `n` blocks sum to a triangular number
+  checksum += static_cast<Sum>(index / 2) * (static_cast<Sum>(block) * n + n * (n - 1) / 2);
 }
 
-export Day09AnswerType Day09Part1(Day09ParsedType const& disk) noexcept {
-  unsigned free{0}, available{0}, needed{0}, block{0};
-  std::size_t checksum{0};
-  auto file = static_cast<unsigned>(disk.size() + (disk.size() & 1));
+// A forward cursor fills gaps while a backward cursor drains files, both reading digits straight from the map
+template <typename Sum> static Sum Compact(std::string_view disk) noexcept {
+  unsigned available{0}, needed{0};
+  std::size_t free{0}, block{0};
+  std::size_t file{disk.size() + (disk.size() & 1)};
+  Sum checksum{0};
   while (free < file) {
     unsigned const size{std::min(needed, available)};
     UpdateChecksum(checksum, block, file, size);
@@ -37,12 +50,12 @@ export Day09AnswerType Day09Part1(Day09ParsedType const& disk) noexcept {
     needed -= size;
     available -= size;
     if (needed == 0) {
-      needed = disk[file -= 2];
+      needed = Digit(disk[file -= 2]);
     }
     if (available == 0) {
-      available = disk[free + 1];
-      UpdateChecksum(checksum, block, free, disk[free]);
-      block += disk[free];
+      available = Digit(disk[free + 1]);
+      UpdateChecksum(checksum, block, free, Digit(disk[free]));
+      block += Digit(disk[free]);
       free += 2;
     }
   }
@@ -50,65 +63,89 @@ export Day09AnswerType Day09Part1(Day09ParsedType const& disk) noexcept {
   return checksum;
 }
 
-static auto MakeFreeBlockMap(std::vector<unsigned> const& disk) {
-  std::vector<std::vector<unsigned>> free(10);
-  for (auto& f : free) {
-    f.reserve(1'024);
+export Day09AnswerType Day09Part1(Day09ParsedType const& disk) noexcept {
+  if (disk.size() < NarrowLength) {
+    return static_cast<Day09AnswerType>(Compact<std::size_t>(disk));
+  } else {
+    return static_cast<Day09AnswerType>(Compact<util::UInt128>(disk));
   }
-  auto block_sorter = [&](unsigned block, auto const& pair) {
-    auto const& [index, size] = pair;
-    if ((index & 1) == 1 and size > 0) {
-      free[size].push_back(block);
-    }
-    return block + size;
-  };
-  unsigned block{std::ranges::fold_left(std::views::enumerate(disk), 0U, block_sorter)};
-  std::ranges::for_each(free, [](auto& f) { std::ranges::make_heap(f, std::greater{}); });
-  return std::pair{block, std::move(free)};
 }
 
-export Day09AnswerType Day09Part2(Day09ParsedType const& disk,
-                                  [[maybe_unused]] Day09AnswerType const& answer) {
-  auto [block, free] = MakeFreeBlockMap(disk);
-  std::size_t checksum{0};
-  for (auto [index, size] : std::views::reverse(std::views::enumerate(disk))) {
-    block -= size;
-    if ((index & 1) == 1) {
-      continue;
+/// \brief Leftmost-fit index over the gaps of a disk map
+///
+/// A max segment tree over gap sizes in disk order: the leftmost gap that can hold a file is found by
+/// descending towards whichever child still has room. Gap sizes are unbounded.
+class FreeSpace {
+  std::size_t leaves_{1};
+  std::vector<unsigned> largest_;
+  // first free block of each gap
+  std::vector<std::size_t> start_;
+
+public:
+  explicit FreeSpace(std::ranges::sized_range auto&& sizes) {
+    std::size_t const gaps{std::ranges::size(sizes) / 2};
+    while (leaves_ < gaps) {
+      leaves_ *= 2;
     }
-    // Find the candidate block to use
-    auto const [block_id, block_size] =
-        std::ranges::fold_left(std::views::drop(std::views::enumerate(free), size),
-                               std::pair{block, std::numeric_limits<unsigned>::max()},
-                               [](auto&& next, auto&& curr) {
-                                 return std::apply([&](long i, auto& heap) {
-                                    if (not heap.empty()) {
-                                      if (auto const first = heap.front(); first < next.first) {
-                                        return std::pair{first, static_cast<unsigned>(i)};
-                                      }
-                                    }
-                                    return next;
-                                  }, curr);
-                               });
-    // Drop larger blocks if all free blocks are to the right of where we currently are
-    if (not free.empty()) {
-      if (auto last = static_cast<unsigned>(free.size() - 1); not free[last].empty()) {
-        if (auto first = free[last].front(); first > block) {
-          free.pop_back();
-        }
+    largest_.assign(2 * leaves_, 0);
+    start_.reserve(gaps);
+    for (std::size_t index{0}, block{0}; unsigned const size : sizes) {
+      if ((index++ & 1) == 1) {
+        largest_[leaves_ + start_.size()] = size;
+        start_.push_back(block);
       }
+      block += size;
     }
-    // Update block
-    if (block_size != std::numeric_limits<unsigned>::max()) {
-      std::ranges::pop_heap(free[block_size], std::greater{});
-      free[block_size].pop_back();
-      if (size < block_size) {
-        free[block_size - size].push_back(block_id + size);
-        std::ranges::push_heap(free[block_size - size], std::greater{});
-      }
+    for (std::size_t node = leaves_ - 1; node > 0; --node) {
+      largest_[node] = std::max(largest_[2 * node], largest_[2 * node + 1]);
+    }
+  }
+
+  /// Claim `size` blocks from the leftmost gap before gap `limit` that can hold them, returning the first
+  /// claimed block
+  [[nodiscard]] std::optional<std::size_t> Take(unsigned size, std::size_t limit) noexcept {
+    if (largest_[1] < size) {
+      return std::nullopt;
+    }
+    std::size_t node{1};
+    while (node < leaves_) {
+      node = 2 * node + (largest_[2 * node] < size);
+    }
+    if (node - leaves_ >= limit) {
+      return std::nullopt;
+    }
+    std::size_t const block{start_[node - leaves_]};
+    start_[node - leaves_] += size;
+    largest_[node] -= size;
+    for (node /= 2; node > 0; node /= 2) {
+      largest_[node] = std::max(largest_[2 * node], largest_[2 * node + 1]);
+    }
+    return block;
+  }
+};
+
+template <typename Sum> static Sum Defragment(std::string_view disk) {
+  auto const sizes = std::views::transform(disk, Digit);
+  FreeSpace free{sizes};
+  std::size_t block{std::ranges::fold_left(sizes, 0ZU, std::plus{})};
+  Sum checksum{0};
+  for (std::size_t index = disk.size(); index-- > 0;) {
+    unsigned const size{Digit(disk[index])};
+    block -= size;
+    if ((index & 1) == 1 or size == 0) {
+      continue;
     }
-    // Update the checksum with the file's location (possibly unchanged).
-    UpdateChecksum(checksum, block_id, static_cast<unsigned>(index), size);
+    // a file only ever moves into a gap to its left; otherwise it stays put
+    UpdateChecksum(checksum, free.Take(size, index / 2).value_or(block), index, size);
   }
   return checksum;
 }
+
+export Day09AnswerType Day09Part2(Day09ParsedType const& disk,
+                                  [[maybe_unused]] Day09AnswerType const& answer) {
+  if (disk.size() < NarrowLength) {
+    return static_cast<Day09AnswerType>(Defragment<std::size_t>(disk));
+  } else {
+    return static_cast<Day09AnswerType>(Defragment<util::UInt128>(disk));
+  }
+}
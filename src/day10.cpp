@@ -1,102 +1,126 @@
 module;
 
-#include <atomic>
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <functional>
+#include <numeric>
+#include <ranges>
+#include <span>
 #include <string_view>
+#include <utility>
 #include <vector>
 
-#include <ankerl/unordered_dense.h>
-
-#include "circular_buffer.hpp"
-#include "hashing.hpp"
-#include "point.hpp"
-
 export module day10;
 
 import threading;
 
-struct GridWithInfo {
+// Cells are addressed by their index in the input, so the newline column doubles as a sentinel between rows
+struct Topography {
   std::string_view grid;
-  int dim;
-  std::vector<Point> trailheads;
+  std::size_t stride;
+  // cells grouped by height (CSR) -- height `h` owns cells[layers[h], layers[h + 1])
+  std::vector<std::uint32_t> cells;
+  std::array<std::uint32_t, 11> layers;
+
+  [[nodiscard]] constexpr inline std::span<std::uint32_t const> Layer(int height) const noexcept {
+    auto const h{static_cast<std::size_t>(height)};
+    return std::span{cells}.subspan(layers[h], layers[h + 1] - layers[h]);
+  }
+
+  /// Visit the neighbours of `cell` that are exactly one step higher
+  inline void ForEachClimb(std::uint32_t cell, auto&& fn) const noexcept {
+    char const next{static_cast<char>(grid[cell] + 1)};
+    for (std::size_t const offset : {std::size_t{1}, -std::size_t{1}, stride, -stride}) {
+      // cells above the first row wrap around to huge indices
+      if (std::size_t const n{cell + offset}; n < grid.size() and grid[n] == next) {
+        fn(static_cast<std::uint32_t>(n));
+      }
+    }
+  }
+};
+
+// What a cell knows about the summits of one block: which of them it can reach, and by how many paths
+struct Trails {
+  std::uint64_t reach;
+  long rating;
 };
 
-export using Day10ParsedType = GridWithInfo;
+export using Day10ParsedType = std::pair<long, long>;
 export using Day10AnswerType = long;
 
-export GridWithInfo Day10Parse(std::string_view input) noexcept {
-  int const dim{static_cast<int>(input.find('\n'))};
-  std::vector<Point> peaks, trailheads;
-  peaks.reserve(250);
-  trailheads.reserve(300);
-  for (Point loc{0, 0}; char c : input) {
-    if (c == '\n') {
-      ++loc.y;
-      loc.x = 0;
-      continue;
-    } else if (c == '0') {
-      trailheads.push_back(loc);
+static Topography Survey(std::string_view input) {
+  Topography topo{.grid = input, .stride = input.find('\n') + 1, .cells = {}, .layers = {}};
+  auto is_height = [](char c) {
+    return '0' <= c and c <= '9';
+  };
+  for (char const c : input) {
+    if (is_height(c)) {
+      ++topo.layers[static_cast<std::size_t>(c - '0') + 1];
     }
-    ++loc.x;
   }
-  return GridWithInfo{.grid = input, .dim = dim, .trailheads = std::move(trailheads)};
+  std::partial_sum(topo.layers.begin(), topo.layers.end(), topo.layers.begin());
+  topo.cells.resize(topo.layers.back());
+  std::array<std::uint32_t, 10> fill;
+  std::copy_n(topo.layers.begin(), fill.size(), fill.begin());
+  for (auto const [index, c] : std::views::enumerate(input)) {
+    if (is_height(c)) {
+      topo.cells[fill[static_cast<std::size_t>(c - '0')]++] = static_cast<std::uint32_t>(index);
+    }
+  }
+  return topo;
 }
 
-static constexpr auto TransparentInsert = [](auto& container, auto const& value) {
-  if constexpr (requires { container.push_back(value); }) {
-    container.push_back(value);
-  } else if constexpr (requires { container.insert(value); }) {
-    container.insert(value);
-  } else if constexpr (requires { container.push(value); }) {
-    container.push(value);
-  } else {
-    static_assert(false, "Unable to insert");
+// Sweep the layers from the summits down: every cell combines the values of the cells one step above it.
+// `value` must already hold the summits' values.
+template <typename T>
+static void Descend(Topography const& topo, std::vector<T>& value, auto&& combine) noexcept {
+  for (int height = 8; height >= 0; --height) {
+    for (std::uint32_t const cell : topo.Layer(height)) {
+      T v{};
+      topo.ForEachClimb(cell, [&](std::uint32_t next) { v = combine(v, value[next]); });
+      value[cell] = v;
+    }
   }
-};
+}
 
-template <typename Container>
-void TraverseFrom(GridWithInfo const& data, std::atomic_long& result, Point const& p) {
-  auto grid = [&data](Point const& p) noexcept { return data.grid[p.Index(data.dim + 1)]; };
-  thread_local CircularBuffer<Point> queue{64};
-  thread_local Container seen;
-  queue.clear();
-  seen.clear();
-  queue.push_back(p);
-  while (not queue.empty()) {
-    Point const curr{queue.back()};
-    queue.pop_back();
-    if (char const curr_height{grid(curr)}; curr_height == '9') {
-      TransparentInsert(seen, curr);
-    } else {
-#pragma unroll
-      for (Dir const dir : {Dir::Up, Dir::Down, Dir::Left, Dir::Right}) {
-        if (Point const next{curr + dir};           //
-            (0 <= next.x and next.x < data.dim) and //
-            (0 <= next.y and next.y < data.dim) and //
-            grid(next) == curr_height + 1) {
-          queue.push_back(next);
-        }
-      }
+// The summits are handled 64 at a time -- every cell carries one word marking which of the current block it
+// can reach along with the number of paths to them. Every path ends at exactly one summit, so ratings add
+// up across blocks, and the blocks are independent so they are spread across the thread pool.
+export Day10ParsedType Day10Parse(std::string_view input) {
+  Topography const topo{Survey(input)};
+  std::span<std::uint32_t const> const summits{topo.Layer(9)};
+  std::size_t const blocks{(summits.size() + 63) / 64};
+  std::vector<std::pair<long, long>> partial(blocks);
+  threading::ParallelForEach(std::views::iota(0ZU, blocks), [&](std::size_t block) {
+    thread_local std::vector<Trails> trails;
+    trails.resize(topo.grid.size());
+    for (std::uint32_t const summit : summits) {
+      trails[summit] = Trails{.reach = 0, .rating = 0};
     }
-  }
-  result += static_cast<int>(seen.size());
+    for (std::size_t i = 64 * block; i < std::min(summits.size(), 64 * block + 64); ++i) {
+      trails[summits[i]] = Trails{.reach = std::uint64_t{1} << (i % 64), .rating = 1};
+    }
+    Descend(topo, trails, [](Trails const& a, Trails const& b) {
+      return Trails{.reach = a.reach | b.reach, .rating = a.rating + b.rating};
+    });
+    auto& [score, rating] = partial[block];
+    for (std::uint32_t const trailhead : topo.Layer(0)) {
+      score += std::popcount(trails[trailhead].reach);
+      rating += trails[trailhead].rating;
+    }
+  });
+  return std::ranges::fold_left(partial, std::pair{0L, 0L}, [](auto const& acc, auto const& p) {
+    return std::pair{acc.first + p.first, acc.second + p.second};
+  });
 }
 
 export Day10AnswerType Day10Part1(Day10ParsedType const& data) noexcept {
-  std::atomic_long result{0};
-  threading::ParallelForEach(data.trailheads,
-                             std::bind_front(TraverseFrom<ankerl::unordered_dense::set<Point, Hash>>,
-                                             std::cref(data),
-                                             std::ref(result)),
-                             threading::GetNumThreads() / 2);
-  return result;
+  return data.first;
 }
 
 export Day10AnswerType Day10Part2(Day10ParsedType const& data,
                                   [[maybe_unused]] Day10AnswerType const& answer) {
-  std::atomic_long result{0};
-  threading::ParallelForEach(
-      data.trailheads,
-      std::bind_front(TraverseFrom<std::vector<Point>>, std::cref(data), std::ref(result)),
-      threading::GetNumThreads() / 2);
-  return result;
+  return data.second;
 }
@@ -1,7 +1,13 @@
 module;
 
 #include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <functional>
+#include <numeric>
 #include <ranges>
+#include <stdexcept>
 #include <string_view>
 #include <vector>
 
@@ -10,7 +16,8 @@ module;
 
 export module day11;
 
-namespace {
+import threading;
+import util;
 
 struct Target {
   unsigned a{0xFFFFFFFF};
@@ -19,54 +26,78 @@ struct Target {
 
 struct ParsedData {
   std::vector<Target> edges;
+  // reverse edges (CSR) -- stone `v` is produced by the stones sources[offsets[v], offsets[v + 1])
+  std::vector<std::uint32_t> offsets, sources;
   std::vector<long> counts;
+  // counts after the first 25 blinks, which part 2 carries on from
+  std::vector<long> part1_counts;
 };
 
+namespace {
+
 static constexpr auto Div = []<std::integral T>(T a, std::same_as<T> auto b) {
   return std::pair{a / b, a % b};
 };
 
-static constexpr auto Digits = [](long value) {
-  long digits{1};
-  for (long num{10}; value >= num; num *= 10) {
-    ++digits;
+static constexpr auto Pow10 = [] {
+  std::array<long, 19> pow10;
+  pow10[0] = 1;
+  for (std::size_t i = 1; i < pow10.size(); ++i) {
+    pow10[i] = pow10[i - 1] * 10;
   }
-  return digits;
+  return pow10;
+}();
+
+// log10 estimated from the bit width (1233 / 4096 ~ log10(2)), then corrected with one table lookup
+static constexpr auto Digits = [](long value) {
+  auto const v{static_cast<unsigned long>(value) | 1};
+  auto const estimate{static_cast<std::size_t>((64 - std::countl_zero(v)) * 1233 >> 12)};
+  return static_cast<long>(estimate) + (v >= static_cast<unsigned long>(Pow10[estimate]));
 };
 
 static constexpr auto Split = [](long value, long digits) {
-  long divisor{10};
-  for (long i = 1; i < digits; ++i) {
-    divisor *= 10;
-  }
-  return Div(value, divisor);
+  return Div(value, Pow10[static_cast<std::size_t>(digits)]);
 };
 
-struct Data {
-  std::size_t index{0};
-  long first;
-  long second;
-};
+} // namespace
 
-static void BuildMapping(ankerl::unordered_dense::map<long, Data>& mapping, long n) {
-  if (mapping.contains(n)) {
-    return;
-  }
-  if (n == 0) {
-    mapping[n] = Data{mapping.size(), 1, -1};
-    BuildMapping(mapping, 1);
-  } else if (long const digits = Digits(n); (digits & 1) == 0) {
-    auto [q, r] = Split(n, digits / 2);
-    mapping[n] = Data{mapping.size(), q, r};
-    BuildMapping(mapping, q);
-    BuildMapping(mapping, r);
+// Graphs this small are stepped on the calling thread; the pool only pays off for much larger stone sets
+static constexpr std::size_t ParallelStones{1ZU << 14};
+
+// Every stone's new count is the sum of its sources' counts, so stones can be computed independently and in
+// any order -- no scatter, no atomics, and no clearing between blinks
+template <typename T, typename Add = std::plus<>>
+static void Step(ParsedData const& data, std::vector<T> const& counts_in, std::vector<T>& counts_out,
+                 Add add = {}) {
+  auto gather = [&](std::size_t first, std::size_t last) {
+    for (std::size_t v = first; v < last; ++v) {
+      T sum{0};
+      for (std::uint32_t k = data.offsets[v]; k < data.offsets[v + 1]; ++k) {
+        sum = add(sum, counts_in[data.sources[k]]);
+      }
+      counts_out[v] = sum;
+    }
+  };
+  std::size_t const stones{counts_in.size()};
+  if (stones < ParallelStones) {
+    gather(0, stones);
   } else {
-    mapping[n] = Data{mapping.size(), n * 2024, -1};
-    BuildMapping(mapping, n * 2024);
+    unsigned const bands{threading::GetNumThreads()};
+    threading::ParallelForEach(std::views::iota(0U, bands), [&](unsigned band) {
+      gather(band * stones / bands, (band + 1) * stones / bands);
+    });
   }
 }
 
-} // namespace
+// Blink `blinks` times, ping-ponging between `counts` and an equally sized `scratch` buffer
+template <typename T, typename Add = std::plus<>>
+static void Blink(ParsedData const& data, std::vector<T>& counts, std::vector<T>& scratch, std::size_t blinks,
+                  Add add = {}) {
+  for (std::size_t i = 0; i < blinks; ++i) {
+    Step(data, counts, scratch, add);
+    std::swap(counts, scratch);
+  }
+}
 
 export using Day11ParsedType = ParsedData;
 export using Day11AnswerType = long;
@@ -76,60 +107,161 @@ export Day11ParsedType Day11Parse(std::string_view input) noexcept {
   auto nums = ctre::search_all<"\\d+">(input) |
               std::views::transform([](auto&& match) { return match.template to_number<long>(); }) |
               std::ranges::to<std::vector>();
-  // construct sparse mapping of values
-  ankerl::unordered_dense::map<long, Data> mapping;
-  for (long n : nums) {
-    BuildMapping(mapping, n);
-  }
-  // convert the mapping to dense (zero-based) edge list
-  std::vector<Target> edges(mapping.size());
-  for (auto const& [n, v] : mapping) {
-    auto const& [i, v0, v1] = v;
-    edges[i].a = static_cast<unsigned>(mapping[v0].index);
-    if (v1 != -1) {
-      edges[i].b = static_cast<unsigned>(mapping[v1].index);
+  // every distinct value gets a dense index in the order it is discovered
+  ankerl::unordered_dense::map<long, std::uint32_t> index;
+  std::vector<long> values;
+  auto intern = [&](long value) {
+    auto const [it, inserted] = index.try_emplace(value, static_cast<std::uint32_t>(values.size()));
+    if (inserted) {
+      values.push_back(value);
+    }
+    return it->second;
+  };
+  auto const stones = nums | std::views::transform(intern) | std::ranges::to<std::vector>();
+  // the values still awaiting edges double as the worklist, so edges come out in dense order
+  std::vector<Target> edges;
+  for (std::size_t i = 0; i < values.size(); ++i) {
+    Target edge;
+    if (long const n{values[i]}; n == 0) {
+      edge.a = intern(1);
+    } else if (long const digits{Digits(n)}; (digits & 1) == 0) {
+      auto const [q, r] = Split(n, digits / 2);
+      edge.a = intern(q);
+      edge.b = intern(r);
+    } else {
+      edge.a = intern(n * 2024);
     }
+    edges.push_back(edge);
   }
   // determine initial counts
-  std::vector<long> counts(mapping.size(), 0L);
-  for (long n : nums) {
-    ++counts[mapping[n].index];
+  std::vector<long> counts(values.size(), 0L);
+  for (std::uint32_t const i : stones) {
+    ++counts[i];
   }
-  // yield results
-  return ParsedData{.edges = std::move(edges), .counts = std::move(counts)};
-}
-
-static void
-Step(std::vector<Target> const& edges, std::vector<long>& counts_in, std::vector<long>& counts_out) {
-  for (auto [i, count] : std::views::enumerate(counts_in)) {
-    Target const& out = edges[static_cast<unsigned>(i)];
-    counts_out[out.a] += count;
-    if (out.b != 0xFFFFFFFF) {
-      counts_out[out.b] += count;
+  // invert the edges so that every stone gathers its count from the stones that produce it
+  std::vector<std::uint32_t> offsets(edges.size() + 1, 0);
+  for (auto const& [a, b] : edges) {
+    ++offsets[a + 1];
+    if (b != 0xFFFFFFFF) {
+      ++offsets[b + 1];
     }
-    count = 0;
   }
+  std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+  std::vector<std::uint32_t> sources(offsets.back());
+  std::vector<std::uint32_t> fill(offsets.begin(), offsets.end() - 1);
+  for (auto const [i, edge] : std::views::enumerate(edges)) {
+    sources[fill[edge.a]++] = static_cast<std::uint32_t>(i);
+    if (edge.b != 0xFFFFFFFF) {
+      sources[fill[edge.b]++] = static_cast<std::uint32_t>(i);
+    }
+  }
+  ParsedData data{.edges = std::move(edges),
+                  .offsets = std::move(offsets),
+                  .sources = std::move(sources),
+                  .counts = std::move(counts),
+                  .part1_counts = {}};
+  data.part1_counts = data.counts;
+  std::vector<long> scratch(data.counts.size());
+  Blink(data, data.part1_counts, scratch, 25);
+  // yield results
+  return data;
 }
 
-static std::vector<long> part1_counts;
-
 export Day11AnswerType Day11Part1(Day11ParsedType const& data) noexcept {
-  part1_counts.assign(data.counts.begin(), data.counts.end());
-  std::vector empty(part1_counts.size(), 0L);
-  for (int i = 0; i < 25; ++i) {
-    Step(data.edges, part1_counts, empty);
-    std::swap(part1_counts, empty);
-  }
-  return std::ranges::fold_left(part1_counts, 0L, std::plus{});
+  return std::ranges::fold_left(data.part1_counts, 0L, std::plus{});
 }
 
 export Day11AnswerType Day11Part2(Day11ParsedType const& data,
                                   [[maybe_unused]] Day11AnswerType const& answer) {
-  std::vector counts{part1_counts};
-  std::vector empty(counts.size(), 0L);
-  for (int i = 0; i < 50; ++i) {
-    Step(data.edges, counts, empty);
-    std::swap(counts, empty);
-  }
+  std::vector counts{data.part1_counts};
+  std::vector<long> scratch(counts.size());
+  Blink(data, counts, scratch, 50);
   return std::ranges::fold_left(counts, 0L, std::plus{});
 }
+
+/// \brief Stone counts after any number of blinks, for many queries over one stone set
+///
+/// The total after `n` blinks is 1'.T^n.c for the transition operator T and initial counts c. Splitting
+/// n = q * Stride + r, it is the dot product of (T')^r.1 -- what each stone becomes after r blinks -- with
+/// T^(q * Stride).c. Both kinds of vector are cached as they are first needed, so a repeated or nearby query
+/// costs a single dot product and the operator itself never has to be formed.
+///
+/// Counts are exact while they fit in 128 bits (roughly 200 blinks for typical stones). A query past that
+/// throws `std::overflow_error` unless a non-zero `modulus` is given, in which case every count is reduced
+/// modulo it. The query object keeps its own copy of the stone graph.
+export class Day11Blinks {
+public:
+  using Count = util::UInt128;
+  static constexpr std::size_t Stride{64};
+
+  explicit Day11Blinks(Day11ParsedType data, std::uint64_t modulus = 0)
+      : data_{std::move(data)}, modulus_{modulus} {
+    giant_.emplace_back(data_.counts.begin(), data_.counts.end());
+    // reduces the initial counts when there is a modulus
+    for (Count& c : giant_.back()) {
+      c = Add(c, 0);
+    }
+  }
+
+  [[nodiscard]] Count operator()(std::size_t blinks) {
+    auto add = [this](Count a, Count b) {
+      return Add(a, b);
+    };
+    std::size_t const q{blinks / Stride}, r{blinks % Stride};
+    while (giant_.size() <= q) {
+      std::vector<Count> counts{giant_.back()}, scratch(counts.size());
+      Blink(data_, counts, scratch, Stride, add);
+      giant_.push_back(std::move(counts));
+    }
+    if (baby_.empty()) {
+      baby_.emplace_back(data_.edges.size(), Count{1});
+    }
+    // a stone becomes whatever its children become one blink later
+    while (baby_.size() <= r) {
+      std::vector<Count> const& prev{baby_.back()};
+      std::vector<Count> next(prev.size());
+      for (std::size_t v = 0; v < next.size(); ++v) {
+        auto const& [a, b] = data_.edges[v];
+        next[v] = Add(prev[a], b != 0xFFFFFFFF ? prev[b] : 0);
+      }
+      baby_.push_back(std::move(next));
+    }
+    Count total{0};
+    for (std::size_t v = 0; v < data_.edges.size(); ++v) {
+      total = Add(total, Mul(giant_[q][v], baby_[r][v]));
+    }
+    if (modulus_ == 0 and total == Overflow) {
+      throw std::overflow_error{"Day11Blinks: count exceeds 128 bits, pass a modulus"};
+    }
+    return total;
+  }
+
+private:
+  // Without a modulus, counts saturate here rather than wrap. A saturated count stays saturated through any
+  // later sum, or product with a non-zero count, so one check on the final total catches every overflow.
+  static constexpr Count Overflow{util::MaxValue<Count>};
+
+  // operands are already reduced, so with a 64-bit modulus neither result can wrap before it is reduced
+  [[nodiscard]] constexpr inline Count Add(Count a, Count b) const noexcept {
+    if (modulus_ != 0) {
+      return (a + b) % modulus_;
+    }
+    Count sum;
+    return __builtin_add_overflow(a, b, &sum) ? Overflow : sum;
+  }
+
+  [[nodiscard]] constexpr inline Count Mul(Count a, Count b) const noexcept {
+    if (modulus_ != 0) {
+      return a * b % modulus_;
+    }
+    Count product;
+    return __builtin_mul_overflow(a, b, &product) ? Overflow : product;
+  }
+
+  Day11ParsedType data_;
+  std::uint64_t modulus_;
+  // counts after every Stride-th blink
+  std::vector<std::vector<Count>> giant_;
+  // for r < Stride, the number of stones each stone becomes after r blinks
+  std::vector<std::vector<Count>> baby_;
+};
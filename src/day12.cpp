@@ -1,74 +1,180 @@
 module;
 
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <numeric>
+#include <ranges>
 #include <string_view>
 #include <utility>
 #include <vector>
 
-#include "point.hpp"
-
 export module day12;
 
-constexpr Dir RotateClockwise(Dir dir) noexcept {
-  return static_cast<Dir>((std::to_underlying(dir) + 1) & 3);
-}
+import threading;
 
-constexpr Dir RotateCounterClockwise(Dir dir) noexcept {
-  return static_cast<Dir>((4 + std::to_underlying(dir) - 1) & 3);
-}
+namespace {
 
-static inline char Get(std::string_view map, int n, Point const& p) {
-  if (0 <= p.x and p.x < n and 0 <= p.y and p.y < n) {
-    return map[p.Index(n + 1)];
-  } else {
-    return 0;
+/// \brief Union-find over the cells of a garden where every root is the smallest index in its set
+///
+/// Linking the larger root under the smaller keeps `parent[i] <= i`, so one forward sweep flattens every
+/// set onto its root.
+class Regions {
+  std::vector<std::uint32_t> parent_;
+
+public:
+  explicit Regions(std::size_t cells) : parent_(cells) {
+    std::iota(parent_.begin(), parent_.end(), 0U);
   }
-}
 
-export using Day12ParsedType = std::pair<int, int>;
-export using Day12AnswerType = int;
-
-export Day12ParsedType Day12Parse(std::string_view input) noexcept {
-  int const n{static_cast<int>(input.find('\n'))};
-  int part1{0}, part2{0};
-  std::vector<char> seen(static_cast<std::size_t>(n * n), false);
-  std::array<Point, 256> stack;
-  unsigned index{0};
-  auto push = [&](Point const& p) { stack[index++] = p; };
-  auto pop = [&]() { return stack[--index]; };
-
-  for (int y = 0; y < n; ++y) {
-    for (int x = 0; x < n; ++x) {
-      if (Point const point{x, y}; not seen[point.Index(n)]) {
-        seen[point.Index(n)] = true;
-        int cells{0}, edges{0}, corners{0};
-        char const plant{input[point.Index(n + 1)]};
-        push(point);
-        while (index != 0) {
-          Point const curr = pop();
-          ++cells;
-          #pragma unroll
-          for (Dir const dir : {Dir::Down, Dir::Right, Dir::Up, Dir::Left}) {
-            if (Point const next{curr + dir}; Get(input, n, next) == plant) {
-              if (not seen[next.Index(n)]) {
-                seen[next.Index(n)] = true;
-                push(next);
-              }
-            } else {
-              // Part 1 solver -- count edges
-              ++edges;
-              // Part 2 solver -- count corners (double-counted)
-              Dir const ccw{RotateCounterClockwise(dir)};
-              corners += (Get(input, n, curr + ccw) != plant or Get(input, n, (curr + ccw) + dir) == plant);
-              Dir const cw{RotateClockwise(dir)};
-              corners += (Get(input, n, curr + cw) != plant or Get(input, n, (curr + cw) + dir) == plant);
-            }
-          }
+  [[nodiscard]] inline std::uint32_t Find(std::uint32_t i) noexcept {
+    while (parent_[i] != i) {
+      i = parent_[i] = parent_[parent_[i]];
+    }
+    return i;
+  }
+
+  inline void Union(std::uint32_t a, std::uint32_t b) noexcept {
+    a = Find(a);
+    b = Find(b);
+    if (a != b) {
+      parent_[std::max(a, b)] = std::min(a, b);
+    }
+  }
+
+  void Flatten() noexcept {
+    for (std::uint32_t& p : parent_) {
+      p = parent_[p];
+    }
+  }
+
+  /// The region of cell `i` -- only meaningful once flattened
+  [[nodiscard]] constexpr inline std::uint32_t operator[](std::uint32_t i) const noexcept {
+    return parent_[i];
+  }
+};
+
+/// \brief A garden copied into a buffer with a one-cell border of sentinels, so that every cell has all
+/// eight neighbours and no probe needs a bounds check
+struct Garden {
+  std::uint32_t width, height, stride;
+  std::vector<char> plants;
+
+  explicit Garden(std::string_view input)
+      : width{static_cast<std::uint32_t>(input.find('\n'))},
+        height{static_cast<std::uint32_t>(input.size() / (input.find('\n') + 1))},
+        stride{width + 2},
+        plants(static_cast<std::size_t>(stride) * (height + 2), '\0') {
+    for (std::uint32_t y = 0; y < height; ++y) {
+      std::ranges::copy(input.substr(y * (width + 1), width), plants.data() + Padded(0, y));
+    }
+  }
+
+  /// Position of cell (x, y) within the padded buffer
+  [[nodiscard]] constexpr inline std::size_t Padded(std::uint32_t x, std::uint32_t y) const noexcept {
+    return static_cast<std::size_t>(y + 1) * stride + x + 1;
+  }
+
+  /// Bit `k` is set when the k-th neighbour (clockwise from north) holds the same plant as the cell at `i`
+  [[nodiscard]] inline unsigned Neighbours(std::size_t i) const noexcept {
+    auto const s{static_cast<std::ptrdiff_t>(stride)};
+    char const* const cell{plants.data() + i};
+    unsigned mask{0};
+    for (unsigned k{0}; std::ptrdiff_t const offset : {-s, 1 - s, std::ptrdiff_t{1}, s + 1, s, s - 1,
+                                                       std::ptrdiff_t{-1}, -s - 1}) {
+      mask |= static_cast<unsigned>(cell[offset] == *cell) << k++;
+    }
+    return mask;
+  }
+};
+
+struct Contribution {
+  unsigned char edges;
+  unsigned char corners;
+};
+
+// What a cell adds to its region's perimeter and corner count, indexed by its neighbour mask. A quadrant is
+// a corner when both orthogonal neighbours differ (convex), or when both match but the diagonal does not
+// (concave). Diagonal matches need no region check: with both orthogonals matching they are connected.
+constexpr std::array<Contribution, 256> Contributions = [] {
+  std::array<Contribution, 256> table;
+  for (unsigned mask = 0; mask < table.size(); ++mask) {
+    auto same = [&](unsigned k) {
+      return ((mask >> (k % 8)) & 1) == 1;
+    };
+    unsigned edges{0}, corners{0};
+    for (unsigned k = 0; k < 8; k += 2) {
+      edges += not same(k);
+      corners += (not same(k) and not same(k + 2)) or (same(k) and same(k + 2) and not same(k + 1));
+    }
+    table[mask] = Contribution{static_cast<unsigned char>(edges), static_cast<unsigned char>(corners)};
+  }
+  return table;
+}();
+
+} // namespace
+
+export using Day12ParsedType = std::pair<long, long>;
+export using Day12AnswerType = long;
+
+// Regions are labelled in two passes. Horizontal bands are labelled independently on the thread pool, and
+// the bands are then stitched together along their first rows. Each cell then adds its own share of its
+// region's area, perimeter, and corners (the number of sides), read from its neighbour mask in one lookup.
+export Day12ParsedType Day12Parse(std::string_view input) {
+  Garden const garden{input};
+  std::uint32_t const w{garden.width}, h{garden.height};
+  Regions regions{static_cast<std::size_t>(w) * h};
+  unsigned const bands{std::max(1U, std::min(threading::GetNumThreads(), h))};
+  auto first_row = [&](unsigned band) {
+    return static_cast<std::uint32_t>(static_cast<std::size_t>(band) * h / bands);
+  };
+  auto same_above = [&](std::uint32_t x, std::uint32_t y) {
+    std::size_t const i{garden.Padded(x, y)};
+    return garden.plants[i] == garden.plants[i - garden.stride];
+  };
+  threading::ParallelForEach(std::views::iota(0U, bands), [&](unsigned band) {
+    for (std::uint32_t y = first_row(band); y < first_row(band + 1); ++y) {
+      for (std::uint32_t x = 0; x < w; ++x) {
+        // the sentinel column keeps the first cell of a row from joining the row's left border
+        if (std::size_t const i{garden.Padded(x, y)}; garden.plants[i] == garden.plants[i - 1]) {
+          regions.Union(y * w + x, y * w + x - 1);
+        }
+        if (y > first_row(band) and same_above(x, y)) {
+          regions.Union(y * w + x, (y - 1) * w + x);
         }
-        part1 += cells * edges;
-        part2 += cells * (corners / 2);
       }
     }
+  });
+  for (unsigned band = 1; band < bands; ++band) {
+    for (std::uint32_t y{first_row(band)}, x = 0; x < w; ++x) {
+      if (same_above(x, y)) {
+        regions.Union(y * w + x, (y - 1) * w + x);
+      }
+    }
+  }
+  regions.Flatten();
+
+  std::vector<long> area(static_cast<std::size_t>(w) * h, 0), perimeter(area), corners(area);
+  auto add = [](long& counter, long value) {
+    std::atomic_ref{counter}.fetch_add(value, std::memory_order_relaxed);
+  };
+  threading::ParallelForEach(std::views::iota(0U, bands), [&](unsigned band) {
+    for (std::uint32_t y = first_row(band); y < first_row(band + 1); ++y) {
+      for (std::uint32_t x = 0; x < w; ++x) {
+        std::uint32_t const region{regions[y * w + x]};
+        auto const [edges, sides] = Contributions[garden.Neighbours(garden.Padded(x, y))];
+        add(area[region], 1);
+        add(perimeter[region], edges);
+        add(corners[region], sides);
+      }
+    }
+  });
+  long part1{0}, part2{0};
+  for (std::size_t region = 0; region < area.size(); ++region) {
+    part1 += area[region] * perimeter[region];
+    part2 += area[region] * corners[region];
   }
   return std::pair{part1, part2};
 }
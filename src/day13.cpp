@@ -1,64 +1,162 @@
 module;
 
 #include <algorithm>
-#include <functional>
-#include <ranges>
+#include <array>
+#include <concepts>
 #include <string_view>
+#include <utility>
 #include <vector>
 
-#include <ctre.hpp>
-
 export module day13;
 
-using Loc = std::pair<long, long>;
+import util;
+
+// Machines are stored column-wise, so every field is one contiguous array the solver can stream through
+struct Machines {
+  std::vector<long> ax, ay, bx, by, px, py;
+  // the largest button step and prize coordinate, which bound every numerator the solver forms
+  long max_step{0}, max_prize{0};
 
-struct Game {
-  Loc a, b, prize;
+  [[nodiscard]] constexpr inline std::size_t Size() const noexcept {
+    return px.size();
+  }
 };
 
-export using Day13ParsedType = std::vector<Game>;
-export using Day13AnswerType = long;
+static constexpr long Far{10'000'000'000'000L};
 
-export Day13ParsedType Day13Parse(std::string_view input) noexcept {
-  auto games = ctre::multiline_search_all<
-      R"(Button A: X\+(\d+), Y\+(\d+)\nButton B: X\+(\d+), Y\+(\d+)\nPrize: X=(\d+), Y=(\d+))">(input);
-  auto parse = [](auto&& match) {
-    auto [_, ax, ay, bx, by, px, py] = match;
-    return Game{.a = Loc{ax.to_number(), ay.to_number()},
-                .b = Loc{bx.to_number(), by.to_number()},
-                .prize = Loc{px.to_number(), py.to_number()}};
-  };
-  return std::ranges::to<std::vector>(std::views::transform(games, parse));
-}
-
-static constexpr auto Div = []<std::integral T>(T a, std::same_as<T> auto b) {
+static constexpr auto Div = []<typename T>(T a, std::same_as<T> auto b) {
   return std::pair{a / b, a % b};
 };
 
-static inline long Simulate(long offset, Game const& game) {
-  auto const [btn_a, btn_b, prize] = game;
-  auto const [ax, ay] = btn_a;
-  auto const [bx, by] = btn_b;
-  auto [x, y] = prize;
-  x += offset;
-  y += offset;
-  if (long const det = by * ax - bx * ay; det == 0) {
+// Cramer's rule in doubles, so the loop over machines vectorises. While both numerators fit in the 53-bit
+// mantissa they convert exactly, and an integral quotient then comes out exact as well -- so truncating the
+// quotient and multiplying back confirms the presses exactly, while a fractional one can never pass.
+static inline long Press(long ax, long ay, long bx, long by, long x, long y) noexcept {
+  long const det{ax * by - ay * bx};
+  // a singular system is rejected below anyway, so it divides by one rather than zero
+  double const d{static_cast<double>(det == 0 ? 1 : det)};
+  long const na{x * by - y * bx}, nb{y * ax - x * ay};
+  long const a{static_cast<long>(static_cast<double>(na) / d)};
+  long const b{static_cast<long>(static_cast<double>(nb) / d)};
+  bool const solved{det != 0 and a * det == na and b * det == nb};
+  return solved ? 3 * a + b : 0;
+}
+
+static constexpr util::Int128
+Cross(util::Int128 x0, util::Int128 y0, util::Int128 x1, util::Int128 y1) noexcept {
+  return x0 * y1 - y0 * x1;
+}
+
+// Integer division in 128 bits, for machines whose numerators could lose precision as doubles
+static inline long PressExact(long ax, long ay, long bx, long by, long x, long y) noexcept {
+  util::Int128 const det{Cross(ax, ay, bx, by)};
+  if (det == 0) {
+    return 0L;
+  } else if (auto const [aq, ar] = Div(Cross(x, y, bx, by), det); ar != 0) {
+    return 0L;
+  } else if (auto const [bq, br] = Div(Cross(ax, ay, x, y), det); br != 0) {
+    return 0L;
+  } else {
+    return static_cast<long>(3 * aq + bq);
+  }
+}
+
+// Bezout coefficients: returns {g, s, t} with s * a + t * b == g == gcd(a, b)
+static constexpr std::array<util::Int128, 3> ExtendedGcd(util::Int128 a, util::Int128 b) noexcept {
+  util::Int128 s{1}, s_next{0}, t{0}, t_next{1};
+  while (b != 0) {
+    util::Int128 const q{a / b};
+    a = std::exchange(b, a - q * b);
+    s = std::exchange(s_next, s - q * s_next);
+    t = std::exchange(t_next, t - q * t_next);
+  }
+  return {a, s, t};
+}
+
+static constexpr util::Int128 FloorDiv(util::Int128 a, util::Int128 b) noexcept {
+  auto const [q, r] = Div(a, b);
+  return q - (r != 0 and (r < 0) != (b < 0));
+}
+
+// Collinear buttons leave a one-dimensional problem along their shared line: a * u + b * v == t. Its integer
+// solutions are one particular solution plus multiples of (v / g, -u / g), along which the cost 3a + b moves
+// linearly -- so the cheapest one sits at whichever end keeps both press counts non-negative.
+static long Collinear(long ax, long ay, long bx, long by, long x, long y) noexcept {
+  if (Cross(ax, ay, x, y) != 0 or Cross(bx, by, x, y) != 0) {
     return 0L;
-  } else if (auto const [bq, br] = Div(y * ax - x * ay, det); br != 0) {
+  }
+  // project onto whichever axis the buttons actually move along
+  bool const along_x{ax != 0 or bx != 0};
+  util::Int128 const u{along_x ? ax : ay}, v{along_x ? bx : by}, t{along_x ? x : y};
+  if (u == 0 and v == 0) {
     return 0L;
-  } else if (auto const [aq, ar] = Div(x - bq * bx, ax); ar != 0) {
+  }
+  auto const [g, s0, t0] = ExtendedGcd(u, v);
+  if (t % g != 0) {
     return 0L;
+  }
+  util::Int128 const a0{s0 * (t / g)}, b0{t0 * (t / g)}, a_step{v / g}, b_step{u / g};
+  // a == a0 + k * a_step and b == b0 - k * b_step; raising k changes the cost by 3 * a_step - b_step
+  util::Int128 const k{3 * a_step < b_step ? FloorDiv(b0, b_step) : -FloorDiv(a0, a_step)};
+  util::Int128 const a{a0 + k * a_step}, b{b0 - k * b_step};
+  return (a < 0 or b < 0) ? 0L : static_cast<long>(3 * a + b);
+}
+
+// Both parts in one pass over the machines, each prize solved as given and pushed out by `Far`
+template <auto Solve> static std::pair<long, long> Tally(Machines const& m) noexcept {
+  long part1{0}, part2{0};
+  for (std::size_t i = 0; i < m.Size(); ++i) {
+    part1 += Solve(m.ax[i], m.ay[i], m.bx[i], m.by[i], m.px[i], m.py[i]);
+    part2 += Solve(m.ax[i], m.ay[i], m.bx[i], m.by[i], m.px[i] + Far, m.py[i] + Far);
+  }
+  // singular machines score nothing above; they are rare, so a second pass keeps the loop above branch-free
+  for (std::size_t i = 0; i < m.Size(); ++i) {
+    if (m.ax[i] * m.by[i] == m.ay[i] * m.bx[i]) {
+      part1 += Collinear(m.ax[i], m.ay[i], m.bx[i], m.by[i], m.px[i], m.py[i]);
+      part2 += Collinear(m.ax[i], m.ay[i], m.bx[i], m.by[i], m.px[i] + Far, m.py[i] + Far);
+    }
+  }
+  return {part1, part2};
+}
+
+export using Day13ParsedType = std::pair<long, long>;
+export using Day13AnswerType = long;
+
+export Day13ParsedType Day13Parse(std::string_view input) {
+  Machines m;
+  // every machine lists exactly six numbers, always in this order
+  std::array const fields{&m.ax, &m.ay, &m.bx, &m.by, &m.px, &m.py};
+  auto is_digit = [](char c) {
+    return '0' <= c and c <= '9';
+  };
+  for (std::size_t field{0}, i = 0; i < input.size();) {
+    if (not is_digit(input[i])) {
+      ++i;
+      continue;
+    }
+    long value{0};
+    for (; i < input.size() and is_digit(input[i]); ++i) {
+      value = value * 10 + (input[i] - '0');
+    }
+    fields[field]->push_back(value);
+    long& bound{field < 4 ? m.max_step : m.max_prize};
+    bound = std::max(bound, value);
+    field = (field + 1) % fields.size();
+  }
+  // a numerator is at most 2 * step * coordinate in magnitude
+  if (util::Int128 const bound{static_cast<util::Int128>(2) * m.max_step * (m.max_prize + Far)};
+      bound < (static_cast<util::Int128>(1) << 53)) {
+    return Tally<Press>(m);
   } else {
-    return 3 * aq + bq;
+    return Tally<PressExact>(m);
   }
 }
 
 export Day13AnswerType Day13Part1(Day13ParsedType const& data) noexcept {
-  return std::ranges::fold_left(std::views::transform(data, std::bind_front(Simulate, 0)), 0L, std::plus{});
+  return data.first;
 }
 
 export Day13AnswerType Day13Part2(Day13ParsedType const& data,
                                   [[maybe_unused]] Day13AnswerType const& answer) {
-  return std::ranges::fold_left(
-      std::views::transform(data, std::bind_front(Simulate, 10'000'000'000'000L)), 0L, std::plus{});
+  return data.second;
 }
@@ -0,0 +1,252 @@
+module;
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <ranges>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "point.hpp"
+
+export module grid_search;
+
+import threading;
+
+export namespace grid_search {
+
+/// \brief A newline-delimited character grid
+struct Grid {
+  std::string_view data;
+  int width, height;
+
+  explicit Grid(std::string_view grid) noexcept
+      : data{grid},
+        width{static_cast<int>(grid.find('\n'))},
+        height{static_cast<int>(grid.size() / (static_cast<std::size_t>(width) + 1))} {
+  }
+
+  [[nodiscard]] constexpr inline bool InBounds(Point const& p) const noexcept {
+    return 0 <= p.x and p.x < width and 0 <= p.y and p.y < height;
+  }
+
+  [[nodiscard]] constexpr inline char operator[](Point const& p) const noexcept {
+    return data[p.Index(width + 1)];
+  }
+};
+
+/// \brief Multi-word search over all eight reading directions of a grid
+///
+/// Words are compiled into a single Aho-Corasick automaton (along with their reversals) so every row,
+/// column, and diagonal is scanned exactly once regardless of how many words are searched for.
+/// Occurrences are counted once per reading direction, so a palindrome is found both forwards and
+/// backwards.
+class WordSearch {
+  static constexpr std::uint32_t Root{0};
+  static constexpr std::uint32_t Missing{std::numeric_limits<std::uint32_t>::max()};
+
+  // byte -> dense symbol; symbol 0 is reserved for bytes that appear in no word
+  std::array<std::uint32_t, 256> alphabet_{};
+  std::uint32_t symbols_{1};
+  // complete transition table, indexed by `node * symbols_ + symbol`
+  std::vector<std::uint32_t> next_;
+  // nearest proper suffix of each node that ends a pattern
+  std::vector<std::uint32_t> link_;
+  // patterns ending exactly at each node (CSR)
+  std::vector<std::uint32_t> out_offsets_, out_;
+  // per pattern: originating word index and length
+  std::vector<std::size_t> word_, length_;
+  std::size_t words_{0}, max_length_{0};
+
+  [[nodiscard]] constexpr inline std::uint32_t Symbol(char c) const noexcept {
+    return alphabet_[static_cast<unsigned char>(c)];
+  }
+
+  [[nodiscard]] constexpr inline std::uint32_t& Next(std::uint32_t node, std::uint32_t symbol) noexcept {
+    return next_[node * symbols_ + symbol];
+  }
+
+  [[nodiscard]] constexpr inline std::uint32_t Next(std::uint32_t node, std::uint32_t symbol) const noexcept {
+    return next_[node * symbols_ + symbol];
+  }
+
+  /// Run the automaton along `steps` cells from `start`, calling `emit(pattern, k)` for each pattern
+  /// ending at the k-th cell
+  void Scan(Grid const& grid, Point start, Point const& step, int steps, auto&& emit) const noexcept {
+    for (std::uint32_t node{Root}; int const k : std::views::iota(0, steps)) {
+      node = Next(node, Symbol(grid[start]));
+      start += step;
+      for (std::uint32_t n{node}; n != Root; n = link_[n]) {
+        for (std::uint32_t i = out_offsets_[n]; i < out_offsets_[n + 1]; ++i) {
+          emit(out_[i], k);
+        }
+      }
+    }
+  }
+
+public:
+  explicit WordSearch(std::span<std::string_view const> words) : words_{words.size()} {
+    for (std::string_view const word : words) {
+      for (char const c : word) {
+        if (std::uint32_t& symbol{alphabet_[static_cast<unsigned char>(c)]}; symbol == 0) {
+          symbol = symbols_++;
+        }
+      }
+    }
+    // build the trie from each word and its reversal
+    std::vector<std::vector<std::uint32_t>> ends(1);
+    next_.assign(symbols_, Missing);
+    auto insert = [&](auto&& pattern, std::size_t word) {
+      std::uint32_t node{Root};
+      for (char const c : pattern) {
+        if (Next(node, Symbol(c)) == Missing) {
+          Next(node, Symbol(c)) = static_cast<std::uint32_t>(ends.size());
+          ends.emplace_back();
+          next_.resize(next_.size() + symbols_, Missing);
+        }
+        node = Next(node, Symbol(c));
+      }
+      ends[node].push_back(static_cast<std::uint32_t>(word_.size()));
+      word_.push_back(word);
+      length_.push_back(std::ranges::size(pattern));
+    };
+    for (auto const [index, word] : std::views::enumerate(words)) {
+      if (not word.empty()) {
+        insert(word, static_cast<std::size_t>(index));
+        insert(std::views::reverse(word), static_cast<std::size_t>(index));
+        max_length_ = std::max(max_length_, word.size());
+      }
+    }
+    // breadth-first completion of the transition table along with output links
+    std::vector<std::uint32_t> fail(ends.size(), Root);
+    link_.assign(ends.size(), Root);
+    std::vector<std::uint32_t> queue;
+    queue.reserve(ends.size());
+    for (std::uint32_t symbol = 0; symbol < symbols_; ++symbol) {
+      if (std::uint32_t& child{Next(Root, symbol)}; child == Missing) {
+        child = Root;
+      } else {
+        queue.push_back(child);
+      }
+    }
+    for (std::size_t head = 0; head < queue.size(); ++head) {
+      std::uint32_t const node{queue[head]};
+      for (std::uint32_t symbol = 0; symbol < symbols_; ++symbol) {
+        if (std::uint32_t& child{Next(node, symbol)}; child == Missing) {
+          child = Next(fail[node], symbol);
+        } else {
+          std::uint32_t const suffix{Next(fail[node], symbol)};
+          fail[child] = suffix;
+          link_[child] = ends[suffix].empty() ? link_[suffix] : suffix;
+          queue.push_back(child);
+        }
+      }
+    }
+    out_offsets_.reserve(ends.size() + 1);
+    out_offsets_.push_back(0);
+    for (auto const& e : ends) {
+      out_.insert(out_.end(), e.begin(), e.end());
+      out_offsets_.push_back(static_cast<std::uint32_t>(out_.size()));
+    }
+  }
+
+  /// Count the occurrences of every word in `grid`, processing horizontal bands on the thread pool
+  [[nodiscard]] std::vector<long> Count(std::string_view input) const {
+    Grid const grid{input};
+    unsigned const bands{
+        std::max(1U, std::min(threading::GetNumThreads(), static_cast<unsigned>(grid.height)))};
+    std::vector partial(bands, std::vector<long>(words_, 0L));
+    threading::ParallelForEach(std::views::iota(0U, bands), [&](unsigned band) {
+      auto& counts = partial[band];
+      int const y0{static_cast<int>(band * static_cast<unsigned>(grid.height) / bands)};
+      int const y1{static_cast<int>((band + 1) * static_cast<unsigned>(grid.height) / bands)};
+      // rows are owned outright by their band
+      for (int y = y0; y < y1; ++y) {
+        Scan(grid, Point{0, y}, Point{1, 0}, grid.width, [&](std::uint32_t pattern, int) {
+          ++counts[word_[pattern]];
+        });
+      }
+      // downward lines read past the band so that a match is counted by the band holding its top row
+      int const limit{std::min(grid.height, y1 + static_cast<int>(max_length_) - 1)};
+      for (Point const step : {Point{0, 1}, Point{1, 1}, Point{-1, 1}}) {
+        auto scan_from = [&](Point const& start) {
+          int steps{limit - start.y};
+          if (step.x > 0) {
+            steps = std::min(steps, grid.width - start.x);
+          } else if (step.x < 0) {
+            steps = std::min(steps, start.x + 1);
+          }
+          Scan(grid, start, step, steps, [&](std::uint32_t pattern, int k) {
+            if (start.y + k - static_cast<int>(length_[pattern]) + 1 < y1) {
+              ++counts[word_[pattern]];
+            }
+          });
+        };
+        for (int x = 0; x < grid.width; ++x) {
+          scan_from(Point{x, y0});
+        }
+        if (step.x != 0) {
+          for (int y = y0 + 1; y < y1; ++y) {
+            scan_from(Point{step.x > 0 ? 0 : grid.width - 1, y});
+          }
+        }
+      }
+    });
+    std::vector<long> counts(words_, 0L);
+    for (auto const& p : partial) {
+      std::ranges::transform(counts, p, counts.begin(), std::plus{});
+    }
+    return counts;
+  }
+};
+
+/// \brief A fixed 2D arrangement of characters, anchored at its top-left cell
+struct Stencil {
+  struct Cell {
+    Point offset;
+    char value;
+  };
+  std::vector<Cell> cells;
+
+  /// Build a stencil from a newline-delimited picture, where `wildcard` matches anything
+  explicit Stencil(std::string_view picture, char wildcard = '.') {
+    for (Point loc{0, 0}; char const c : picture) {
+      if (c == '\n') {
+        ++loc.y;
+        loc.x = 0;
+        continue;
+      } else if (c != wildcard) {
+        cells.emplace_back(loc, c);
+      }
+      ++loc.x;
+    }
+  }
+
+  [[nodiscard]] bool MatchesAt(Grid const& grid, Point const& anchor) const noexcept {
+    return std::ranges::all_of(cells, [&](Cell const& cell) {
+      Point const p{anchor + cell.offset};
+      return grid.InBounds(p) and grid[p] == cell.value;
+    });
+  }
+};
+
+/// Count the placements of any of `stencils` in `grid`, processing rows on the thread pool
+[[nodiscard]] long CountStencils(std::string_view input, std::span<Stencil const> stencils) {
+  Grid const grid{input};
+  return threading::ParallelReduceAdd(
+      std::views::iota(0, grid.height),
+      [&](int y) {
+        long count{0};
+        for (int x = 0; x < grid.width; ++x) {
+          for (Stencil const& stencil : stencils) {
+            count += stencil.MatchesAt(grid, Point{x, y});
+          }
+        }
+        return count;
+      },
+      0L);
+}
+
+} // namespace grid_search
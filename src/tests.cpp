@@ -1,3 +1,6 @@
+#include <array>
+#include <stdexcept>
+#include <string>
 #include <string_view>
 
 #include <catch2/catch_test_macros.hpp>
@@ -19,6 +22,7 @@ import day11;
 import day12;
 import day13;
 import day14;
+import grid_search;
 
 template <typename Part1Answer, typename Part2Answer> struct Data {
   constexpr Data(Part1Answer p1, Part2Answer p2, std::string_view input) noexcept
@@ -206,3 +210,138 @@ EMIT_TEST(Day11)
 EMIT_TEST(Day12)
 EMIT_TEST(Day13)
 // no tests for 14 due to hard-coded sizes with no way to detect under test
+
+TEST_CASE("Day03 Streaming") {
+  constexpr std::string_view input{R"(xmul(2,4)&mul[3,7]!^don't()_mul(5,5)+mul(32,64](mul(11,8)undo()?mul(8,5))
+)"};
+  for (std::size_t chunk = 1; chunk <= input.size(); ++chunk) {
+    Day03Scanner scanner;
+    for (std::size_t i = 0; i < input.size(); i += chunk) {
+      scanner.Feed(input.substr(i, chunk));
+    }
+    REQUIRE(scanner.Total() == 161);
+    REQUIRE(scanner.Enabled() == 48);
+  }
+}
+
+TEST_CASE("Day03 Parallel") {
+  constexpr std::string_view input{R"(xmul(2,4)&mul[3,7]!^don't()_mul(5,5)+mul(32,64](mul(11,8)undo()?mul(8,5))
+)"};
+  for (unsigned chunks = 1; chunks <= input.size(); ++chunks) {
+    REQUIRE(Day03ParallelScan(input, chunks) == std::pair{161L, 48L});
+  }
+}
+
+TEST_CASE("Grid Search") {
+  constexpr std::array words{"XMAS"sv, "MAS"sv};
+  auto counts = grid_search::WordSearch{words}.Count(Day04Data.input);
+  REQUIRE(counts[0] == Day04Data.part1);
+  REQUIRE(counts[1] == 38);
+  std::array const stencils{grid_search::Stencil{"M.S\n.A.\nM.S"},
+                            grid_search::Stencil{"S.M\n.A.\nS.M"},
+                            grid_search::Stencil{"M.M\n.A.\nS.S"},
+                            grid_search::Stencil{"S.S\n.A.\nM.M"}};
+  REQUIRE(grid_search::CountStencils(Day04Data.input, stencils) == Day04Data.part2);
+}
+
+TEST_CASE("Day05 Page Widths") {
+  // one-, two-, and three-digit pages, with pages above 99 in both the rules and the updates
+  constexpr std::string_view input{R"(250|7
+250|123
+250|5
+250|1
+7|123
+7|5
+7|1
+123|5
+123|1
+5|1
+
+250,7,123
+5,123,7
+7,250,5
+123,5,1
+)"};
+  auto parsed = Day05Parse(input);
+  auto part1 = Day05Part1(parsed);
+  REQUIRE(part1 == 12);
+  REQUIRE(Day05Part2(parsed, part1) == 130);
+}
+
+TEST_CASE("Day08 Rectangular") {
+  // wider than tall, with more than four antennas of one frequency
+  constexpr std::string_view input{R"(..........a.....
+...a............
+.......a........
+.a..........a...
+....a...........
+)"};
+  auto parsed = Day08Parse(input);
+  auto part1 = Day08Part1(parsed);
+  REQUIRE(part1 == 5);
+  REQUIRE(Day08Part2(parsed, part1) == 10);
+}
+
+TEST_CASE("Day11 Blink Queries") {
+  auto parsed = Day11Parse("125 17\n");
+  Day11Blinks blinks{parsed};
+  REQUIRE(blinks(6) == 22);
+  REQUIRE(blinks(25) == 55'312);
+  REQUIRE(blinks(0) == 2);
+  Day11Blinks modular{parsed, 1'000};
+  REQUIRE(modular(25) == 312);
+  // past 128 bits only the modular counts are defined
+  REQUIRE_THROWS_AS(blinks(1'000), std::overflow_error);
+  REQUIRE(modular(1'000) == 924);
+  // the query object owns its stone graph, so it can outlive the parse result
+  Day11Blinks owning{Day11Parse("125 17\n")};
+  REQUIRE(owning(25) == 55'312);
+}
+
+TEST_CASE("Day13 Collinear") {
+  // every machine's buttons move along the same line, so none has a unique solution
+  constexpr std::string_view input{R"(Button A: X+4, Y+4
+Button B: X+1, Y+1
+Prize: X=10, Y=10
+
+Button A: X+2, Y+2
+Button B: X+4, Y+4
+Prize: X=7, Y=7
+
+Button A: X+2, Y+3
+Button B: X+4, Y+6
+Prize: X=10, Y=15
+)"};
+  auto parsed = Day13Parse(input);
+  auto part1 = Day13Part1(parsed);
+  REQUIRE(part1 == 13);
+  REQUIRE(Day13Part2(parsed, part1) == 7'500'000'000'008L);
+}
+
+TEST_CASE("Day07 Wide") {
+  // every target is longer than 18 digits, so each trial is solved in 128 bits
+  auto solve = [](std::string_view input) {
+    auto parsed = Day07Parse(input);
+    auto part1 = Day07Part1(parsed);
+    return std::array{util::ToString(part1), util::ToString(Day07Part2(parsed, part1))};
+  };
+  SECTION("Add") {
+    auto [part1, part2] = solve("30000000000000000000: 10000000000000000000 20000000000000000000\n");
+    REQUIRE(part1 == "30000000000000000000");
+    REQUIRE(part2 == "30000000000000000000");
+  }
+  SECTION("Multiply") {
+    auto [part1, part2] = solve("200000000000000000000000: 100000000000 1000000000000 2\n");
+    REQUIRE(part1 == "200000000000000000000000");
+    REQUIRE(part2 == "200000000000000000000000");
+  }
+  SECTION("Concatenate") {
+    auto [part1, part2] = solve("123456789012345678901234: 123456789012 345678901234\n");
+    REQUIRE(part1 == "0");
+    REQUIRE(part2 == "123456789012345678901234");
+  }
+  SECTION("Too Long") {
+    REQUIRE_THROWS_AS(Day07Parse("1000000000000000000000000000000000000000: 1 2\n"), std::invalid_argument);
+    REQUIRE_THROWS_AS(Day07Parse("3: 1000000000000000000000000000000000000000 2\n"), std::invalid_argument);
+  }
+}
@@ -1,6 +1,8 @@
 module;
 
+#include <algorithm>
 #include <functional>
+#include <limits>
 #include <stdexcept>
 #include <string>
 
@@ -13,6 +15,15 @@ export module util;
 
 export namespace util {
 
+// The 128-bit integers are a GNU extension; naming them once here keeps -Wpedantic quiet everywhere else
+__extension__ using Int128 = __int128;
+__extension__ using UInt128 = unsigned __int128;
+
+/// \brief Largest value of `Int` -- `std::numeric_limits` only covers the 128-bit types in GNU mode
+template <typename Int> constexpr Int MaxValue{std::numeric_limits<Int>::max()};
+template <> constexpr Int128 MaxValue<Int128>{static_cast<Int128>(~UInt128{0} >> 1)};
+template <> constexpr UInt128 MaxValue<UInt128>{~UInt128{0}};
+
 template <typename Fn> struct OnScopeExit {
 
   explicit OnScopeExit(Fn&& f) : fn_{std::move(f)} {
@@ -52,4 +63,19 @@ private:
   }
 }
 
+/// \brief Decimal representation of a 128-bit answer, which `std::to_string` does not cover
+[[nodiscard]] std::string ToString(Int128 value) {
+  UInt128 magnitude{value < 0 ? -static_cast<UInt128>(value) : static_cast<UInt128>(value)};
+  std::string s;
+  do {
+    s.push_back(static_cast<char>('0' + static_cast<int>(magnitude % 10)));
+    magnitude /= 10;
+  } while (magnitude != 0);
+  if (value < 0) {
+    s.push_back('-');
+  }
+  std::ranges::reverse(s);
+  return s;
+}
+
 } // namespace util